@@ -0,0 +1,311 @@
+#include "archivereader.h"
+#include "contentmatcher.h"
+#include <QByteArray>
+#include <QFile>
+#include <QtEndian>
+
+#ifdef EXPLOSION_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef EXPLOSION_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+const qint64 INPUT_CHUNK_SIZE = 64 * 1024;
+const qint64 OUTPUT_CHUNK_SIZE = 256 * 1024;
+
+const quint32 ZIP_LOCAL_HEADER = 0x04034b50;
+const quint32 ZIP_CENTRAL_HEADER = 0x02014b50;
+const quint32 ZIP_END_OF_DIRECTORY = 0x06054b50;
+const quint32 ZIP64_END_OF_DIRECTORY = 0x06064b50;
+const quint32 ZIP64_LOCATOR = 0x07064b50;
+
+inline bool isCancelled(const std::atomic<bool>* cancelled) {
+    return cancelled && cancelled->load(std::memory_order_relaxed);
+}
+
+inline quint16 le16(const char* p) { return qFromLittleEndian<quint16>(p); }
+inline quint32 le32(const char* p) { return qFromLittleEndian<quint32>(p); }
+inline quint64 le64(const char* p) { return qFromLittleEndian<quint64>(p); }
+
+bool copyStored(QFile& file, qint64 length, ContentMatcher::Stream& stream, const std::atomic<bool>* cancelled) {
+    QByteArray buffer(OUTPUT_CHUNK_SIZE, Qt::Uninitialized);
+    while (length > 0 && !isCancelled(cancelled)) {
+        qint64 got = file.read(buffer.data(), qMin<qint64>(buffer.size(), length));
+        if (got <= 0)
+            return false;
+        length -= got;
+        if (!stream.feed(buffer.constData(), got))
+            break;
+    }
+    return true;
+}
+
+#ifdef EXPLOSION_HAVE_ZLIB
+
+bool inflateStream(QFile& file, qint64 limit, bool raw, ContentMatcher::Stream& stream,
+                   const std::atomic<bool>* cancelled) {
+    z_stream z = {};
+    if (inflateInit2(&z, raw ? -MAX_WBITS : MAX_WBITS + 32) != Z_OK)
+        return false;
+
+    QByteArray input(INPUT_CHUNK_SIZE, Qt::Uninitialized);
+    QByteArray output(OUTPUT_CHUNK_SIZE, Qt::Uninitialized);
+    qint64 remaining = limit;
+
+    while (!isCancelled(cancelled)) {
+        if (z.avail_in == 0) {
+            qint64 want = remaining < 0 ? INPUT_CHUNK_SIZE : qMin(INPUT_CHUNK_SIZE, remaining);
+            qint64 got = want > 0 ? file.read(input.data(), want) : 0;
+            if (got <= 0)
+                break;
+            if (remaining >= 0)
+                remaining -= got;
+            z.next_in = reinterpret_cast<Bytef*>(input.data());
+            z.avail_in = uInt(got);
+        }
+
+        z.next_out = reinterpret_cast<Bytef*>(output.data());
+        z.avail_out = uInt(output.size());
+        int ret = inflate(&z, Z_NO_FLUSH);
+
+        qint64 produced = output.size() - qint64(z.avail_out);
+        if (produced > 0 && !stream.feed(output.constData(), produced))
+            break;
+
+        if (ret == Z_STREAM_END) {
+            if (raw)
+                break;
+            inflateReset(&z);
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            break;
+        }
+    }
+
+    inflateEnd(&z);
+    return true;
+}
+
+#endif
+
+#ifdef EXPLOSION_HAVE_ZSTD
+
+bool decompressZstd(QFile& file, ContentMatcher::Stream& stream, const std::atomic<bool>* cancelled) {
+    ZSTD_DStream* dstream = ZSTD_createDStream();
+    if (!dstream)
+        return false;
+    ZSTD_initDStream(dstream);
+
+    QByteArray input(qint64(ZSTD_DStreamInSize()), Qt::Uninitialized);
+    QByteArray output(qint64(ZSTD_DStreamOutSize()), Qt::Uninitialized);
+    bool wantMore = true;
+
+    qint64 got;
+    while (wantMore && !isCancelled(cancelled) && (got = file.read(input.data(), input.size())) > 0) {
+        ZSTD_inBuffer in = {input.constData(), size_t(got), 0};
+        while (wantMore && in.pos < in.size) {
+            ZSTD_outBuffer out = {output.data(), size_t(output.size()), 0};
+            size_t ret = ZSTD_decompressStream(dstream, &out, &in);
+            if (ZSTD_isError(ret)) {
+                wantMore = false;
+                break;
+            }
+            if (out.pos > 0 && !stream.feed(output.constData(), qint64(out.pos)))
+                wantMore = false;
+        }
+    }
+
+    while (wantMore) {
+        ZSTD_inBuffer in = {nullptr, 0, 0};
+        ZSTD_outBuffer out = {output.data(), size_t(output.size()), 0};
+        size_t ret = ZSTD_decompressStream(dstream, &out, &in);
+        if (ZSTD_isError(ret) || out.pos == 0 || !stream.feed(output.constData(), qint64(out.pos)))
+            break;
+    }
+
+    ZSTD_freeDStream(dstream);
+    return true;
+}
+
+#endif
+
+bool scanZipMember(QFile& file, quint16 method, qint64 compressedSize, qint64 localOffset,
+                   const ContentMatcher& matcher, const std::atomic<bool>* cancelled) {
+    if (!file.seek(localOffset))
+        return false;
+
+    QByteArray local = file.read(30);
+    if (local.size() < 30 || le32(local.constData()) != ZIP_LOCAL_HEADER)
+        return false;
+
+    qint64 dataOffset = localOffset + 30 + le16(local.constData() + 26) + le16(local.constData() + 28);
+    if (!file.seek(dataOffset))
+        return false;
+
+    ContentMatcher::Stream stream(matcher);
+    if (method == 0) {
+        copyStored(file, compressedSize, stream, cancelled);
+    } else {
+#ifdef EXPLOSION_HAVE_ZLIB
+        inflateStream(file, compressedSize, true, stream, cancelled);
+#else
+        return false;
+#endif
+    }
+    return stream.finish();
+}
+
+void scanZip(QFile& file, const ContentMatcher& matcher, QStringList* matchedMembers,
+             const std::atomic<bool>* cancelled) {
+    qint64 size = file.size();
+    qint64 tailSize = qMin<qint64>(size, 0xFFFF + 22);
+    if (tailSize < 22 || !file.seek(size - tailSize))
+        return;
+
+    QByteArray tail = file.read(tailSize);
+    qsizetype eocd = -1;
+    for (qsizetype i = tail.size() - 22; i >= 0; --i) {
+        if (le32(tail.constData() + i) == ZIP_END_OF_DIRECTORY) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0)
+        return;
+
+    quint64 entries = le16(tail.constData() + eocd + 10);
+    quint64 directoryOffset = le32(tail.constData() + eocd + 16);
+
+    if ((entries == 0xFFFF || directoryOffset == 0xFFFFFFFF) && eocd >= 20 &&
+        le32(tail.constData() + eocd - 20) == ZIP64_LOCATOR) {
+        quint64 recordOffset = le64(tail.constData() + eocd - 20 + 8);
+        if (!file.seek(qint64(recordOffset)))
+            return;
+        QByteArray record = file.read(56);
+        if (record.size() < 56 || le32(record.constData()) != ZIP64_END_OF_DIRECTORY)
+            return;
+        entries = le64(record.constData() + 32);
+        directoryOffset = le64(record.constData() + 48);
+    }
+
+    qint64 position = qint64(directoryOffset);
+    for (quint64 entry = 0; entry < entries && !isCancelled(cancelled); ++entry) {
+        if (!file.seek(position))
+            return;
+
+        QByteArray header = file.read(46);
+        if (header.size() < 46 || le32(header.constData()) != ZIP_CENTRAL_HEADER)
+            return;
+
+        const char* h = header.constData();
+        quint16 method = le16(h + 10);
+        quint64 compressedSize = le32(h + 20);
+        quint64 uncompressedSize = le32(h + 24);
+        quint16 nameLength = le16(h + 28);
+        quint16 extraLength = le16(h + 30);
+        quint16 commentLength = le16(h + 32);
+        quint64 localOffset = le32(h + 42);
+
+        QByteArray name = file.read(nameLength);
+        QByteArray extra = file.read(extraLength);
+        position += 46 + nameLength + extraLength + commentLength;
+
+        for (qsizetype i = 0; i + 4 <= extra.size();) {
+            quint16 id = le16(extra.constData() + i);
+            quint16 length = le16(extra.constData() + i + 2);
+            if (id == 0x0001) {
+                qsizetype field = i + 4;
+                if (uncompressedSize == 0xFFFFFFFF && field + 8 <= extra.size()) {
+                    uncompressedSize = le64(extra.constData() + field);
+                    field += 8;
+                }
+                if (compressedSize == 0xFFFFFFFF && field + 8 <= extra.size()) {
+                    compressedSize = le64(extra.constData() + field);
+                    field += 8;
+                }
+                if (localOffset == 0xFFFFFFFF && field + 8 <= extra.size())
+                    localOffset = le64(extra.constData() + field);
+                break;
+            }
+            i += 4 + length;
+        }
+
+        if (name.endsWith('/') || (method != 0 && method != 8) || uncompressedSize == 0)
+            continue;
+
+        if (scanZipMember(file, method, qint64(compressedSize), qint64(localOffset), matcher, cancelled))
+            *matchedMembers << QString::fromUtf8(name);
+    }
+}
+
+}
+
+ArchiveReader::Format ArchiveReader::detect(const QString& filePath) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return Format::None;
+
+    QByteArray magic = file.read(4);
+    if (magic.size() >= 2 && uchar(magic[0]) == 0x1f && uchar(magic[1]) == 0x8b)
+        return Format::Gzip;
+    if (magic.size() == 4 && le32(magic.constData()) == 0xFD2FB528)
+        return Format::Zstd;
+    if (magic.size() == 4 && (le32(magic.constData()) == ZIP_LOCAL_HEADER ||
+                              le32(magic.constData()) == ZIP_END_OF_DIRECTORY))
+        return Format::Zip;
+    return Format::None;
+}
+
+bool ArchiveReader::isSupported(Format format) {
+    switch (format) {
+        case Format::Gzip:
+#ifdef EXPLOSION_HAVE_ZLIB
+            return true;
+#else
+            return false;
+#endif
+        case Format::Zstd:
+#ifdef EXPLOSION_HAVE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+        case Format::Zip:
+            return true;
+        case Format::None:
+            break;
+    }
+    return false;
+}
+
+bool ArchiveReader::scan(const QString& filePath, const ContentMatcher& matcher, QStringList* matchedMembers,
+                         const std::atomic<bool>* cancelled) {
+    Format format = detect(filePath);
+    if (!isSupported(format))
+        return false;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return true;
+
+    if (format == Format::Zip) {
+        scanZip(file, matcher, matchedMembers, cancelled);
+        return true;
+    }
+
+    ContentMatcher::Stream stream(matcher);
+#ifdef EXPLOSION_HAVE_ZLIB
+    if (format == Format::Gzip)
+        inflateStream(file, -1, false, stream, cancelled);
+#endif
+#ifdef EXPLOSION_HAVE_ZSTD
+    if (format == Format::Zstd)
+        decompressZstd(file, stream, cancelled);
+#endif
+    if (stream.finish())
+        *matchedMembers << QString();
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef ARCHIVEREADER_H
+#define ARCHIVEREADER_H
+
+#include <QString>
+#include <QStringList>
+#include <atomic>
+
+class ContentMatcher;
+
+class ArchiveReader {
+public:
+    enum class Format {
+        None,
+        Gzip,
+        Zstd,
+        Zip
+    };
+
+    static Format detect(const QString& filePath);
+
+    static bool isSupported(Format format);
+
+    static bool scan(const QString& filePath, const ContentMatcher& matcher, QStringList* matchedMembers,
+                     const std::atomic<bool>* cancelled = nullptr);
+};
+
+#endif
@@ -0,0 +1,316 @@
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "../searchmanager.h"
+
+namespace {
+
+const char NEEDLE[] = "explosionneedle";
+// Written into every generated tree; only a directory holding it is ever deleted or regenerated.
+const char TREE_MARKER[] = ".explosion-bench-tree";
+
+const char* const DEFAULT_CORPUS[] = {
+    "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel", "india", "juliet",
+    "kilo", "lima", "mike", "november", "oscar", "papa", "quebec", "romeo", "sierra", "tango",
+    "uniform", "victor", "whiskey", "xray", "yankee", "zulu", "report", "invoice", "photo", "draft",
+    "backup", "config", "module", "server", "client", "build", "release", "notes", "summary", "index"
+};
+
+const char* const EXTENSIONS[] = {"txt", "log", "md", "cpp", "h", "json", "csv", "dat"};
+
+struct TreeSpec {
+    int depth;
+    int fanout;
+    int filesPerDir;
+    qint64 minSize;
+    qint64 maxSize;
+    double needleRatio;
+    quint64 seed;
+    QStringList corpus;
+};
+
+struct TreeStats {
+    qint64 files = 0;
+    qint64 directories = 0;
+    qint64 bytes = 0;
+};
+
+class TreeGenerator {
+public:
+    explicit TreeGenerator(const TreeSpec& spec) : spec(spec), random(spec.seed) {}
+
+    TreeStats generate(const QString& root) {
+        stats = TreeStats();
+        populate(root, 0);
+        return stats;
+    }
+
+private:
+    const TreeSpec& spec;
+    std::mt19937_64 random;
+    TreeStats stats;
+
+    const QString& word() {
+        return spec.corpus[int(random() % quint64(spec.corpus.size()))];
+    }
+
+    // Log-uniform sizes give the long tail real trees have: many small files, few large ones.
+    qint64 fileSize() {
+        std::uniform_real_distribution<double> exponent(std::log(double(spec.minSize)), std::log(double(spec.maxSize)));
+        return qint64(std::exp(exponent(random)));
+    }
+
+    void writeFile(const QString& path, qint64 size) {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly))
+            return;
+
+        std::bernoulli_distribution hasNeedle(spec.needleRatio);
+        qint64 needleAt = hasNeedle(random) ? qint64(random() % quint64(qMax<qint64>(1, size))) : -1;
+
+        QByteArray chunk;
+        qint64 written = 0;
+        while (written < size) {
+            chunk.clear();
+            while (chunk.size() < 64 * 1024 && written + chunk.size() < size) {
+                if (needleAt >= 0 && written + chunk.size() >= needleAt) {
+                    chunk += NEEDLE;
+                    needleAt = -1;
+                } else {
+                    chunk += word().toUtf8();
+                }
+                chunk += (random() % 12 == 0) ? '\n' : ' ';
+            }
+            qint64 take = qMin<qint64>(chunk.size(), size - written);
+            file.write(chunk.constData(), take);
+            written += take;
+        }
+
+        ++stats.files;
+        stats.bytes += size;
+    }
+
+    void populate(const QString& directory, int level) {
+        QDir().mkpath(directory);
+        ++stats.directories;
+
+        for (int i = 0; i < spec.filesPerDir; ++i) {
+            QString first = word();
+            QString second = word();
+            QString name = QString("%1_%2_%3.%4").arg(first, second).arg(i)
+                               .arg(EXTENSIONS[random() % std::size(EXTENSIONS)]);
+            writeFile(directory + '/' + name, fileSize());
+        }
+
+        if (level >= spec.depth)
+            return;
+        for (int i = 0; i < spec.fanout; ++i)
+            populate(directory + '/' + QString("%1_%2").arg(word()).arg(i), level + 1);
+    }
+};
+
+double percentile(std::vector<double> samples, double fraction) {
+    if (samples.empty())
+        return 0;
+    std::sort(samples.begin(), samples.end());
+    size_t rank = size_t(std::ceil(fraction * double(samples.size()))) - 1;
+    return samples[std::min(rank, samples.size() - 1)];
+}
+
+QJsonObject runScenario(SearchManager& manager, const QString& name, const QString& query,
+                        const TreeStats& tree, int iterations) {
+    std::vector<double> latencies;
+    int results = 0;
+
+    for (int i = 0; i < iterations; ++i) {
+        QEventLoop loop;
+        QObject::connect(&manager, &SearchManager::searchFinished, &loop, [&](int count) {
+            if (count >= 0) {
+                results = count;
+                loop.quit();
+            }
+        });
+
+        QElapsedTimer timer;
+        timer.start();
+        manager.quickSearch(query);
+        loop.exec();
+        latencies.push_back(double(timer.nsecsElapsed()) / 1e6);
+
+        manager.clearSearch();
+    }
+
+    double total = 0;
+    for (double latency : latencies)
+        total += latency;
+    double meanSecs = total / double(latencies.size()) / 1000.0;
+
+    QJsonArray samples;
+    for (double latency : latencies)
+        samples.append(latency);
+
+    QJsonObject result;
+    result["name"] = name;
+    result["query"] = query;
+    result["iterations"] = iterations;
+    result["results"] = results;
+    result["files_per_sec"] = meanSecs > 0 ? double(tree.files) / meanSecs : 0.0;
+    result["bytes_per_sec"] = meanSecs > 0 ? double(tree.bytes) / meanSecs : 0.0;
+    result["p50_ms"] = percentile(latencies, 0.50);
+    result["p99_ms"] = percentile(latencies, 0.99);
+    result["samples_ms"] = samples;
+    return result;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    QApplication::setApplicationName("explosion-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Generates a synthetic tree and measures search throughput.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"root", "Generate the tree here instead of a temporary directory. It must be empty, missing, or a tree an "
+                 "earlier run generated.", "dir"},
+        {"keep", "Reuse an existing tree under --root instead of regenerating it."},
+        {"depth", "Directory depth.", "n", "3"},
+        {"fanout", "Subdirectories per directory.", "n", "6"},
+        {"files", "Files per directory.", "n", "40"},
+        {"min-size", "Smallest file size in bytes.", "bytes", "256"},
+        {"max-size", "Largest file size in bytes.", "bytes", "1048576"},
+        {"needle-ratio", "Fraction of files whose contents hold the search needle.", "ratio", "0.05"},
+        {"corpus", "Text file with words used for names and contents.", "file"},
+        {"seed", "Random seed.", "n", "42"},
+        {"iterations", "Runs per scenario.", "n", "10"},
+        {"output", "Write the JSON report here instead of stdout.", "file"},
+    });
+    parser.process(app);
+
+    TreeSpec spec;
+    spec.depth = parser.value("depth").toInt();
+    spec.fanout = parser.value("fanout").toInt();
+    spec.filesPerDir = parser.value("files").toInt();
+    spec.minSize = qMax<qint64>(1, parser.value("min-size").toLongLong());
+    spec.maxSize = qMax(spec.minSize, parser.value("max-size").toLongLong());
+    spec.needleRatio = qBound(0.0, parser.value("needle-ratio").toDouble(), 1.0);
+    spec.seed = parser.value("seed").toULongLong();
+
+    if (parser.isSet("corpus")) {
+        QFile corpus(parser.value("corpus"));
+        if (corpus.open(QIODevice::ReadOnly | QIODevice::Text))
+            spec.corpus = QString::fromUtf8(corpus.readAll()).split(QRegularExpression("\\W+"), Qt::SkipEmptyParts);
+    }
+    if (spec.corpus.isEmpty()) {
+        for (const char* word : DEFAULT_CORPUS)
+            spec.corpus << QString::fromLatin1(word);
+    }
+
+    // Keep the user's settings (filename index and friends) out of the measurement.
+    QTemporaryDir settingsDir;
+    QSettings::setPath(QSettings::NativeFormat, QSettings::UserScope, settingsDir.path());
+
+    QTemporaryDir scratch;
+    QString root = parser.isSet("root") ? parser.value("root") : scratch.path() + "/tree";
+
+    QElapsedTimer generateTimer;
+    generateTimer.start();
+    TreeStats tree;
+    QDir rootDir(root);
+    bool generated = QFileInfo::exists(rootDir.filePath(TREE_MARKER));
+    bool empty = !rootDir.exists() || rootDir.isEmpty(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden);
+    if (!generated && !empty) {
+        qCritical("%s is not empty and was not generated by explosion-bench; refusing to overwrite it",
+                  qPrintable(root));
+        return 1;
+    }
+
+    if (parser.isSet("keep") && generated) {
+        QDirIterator it(root, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            it.next();
+            if (it.fileName() == QLatin1String(TREE_MARKER))
+                continue;
+            if (it.fileInfo().isDir()) {
+                ++tree.directories;
+            } else {
+                ++tree.files;
+                tree.bytes += it.fileInfo().size();
+            }
+        }
+    } else {
+        if (generated)
+            rootDir.removeRecursively();
+        // Marked before the first file goes in, so an interrupted run can still be cleaned up by the next.
+        QDir().mkpath(root);
+        QFile marker(rootDir.filePath(TREE_MARKER));
+        if (!marker.open(QIODevice::WriteOnly)) {
+            qCritical("Cannot write %s", qPrintable(marker.fileName()));
+            return 1;
+        }
+        marker.close();
+        tree = TreeGenerator(spec).generate(root);
+    }
+    qint64 generateMsecs = generateTimer.elapsed();
+
+    SearchManager manager;
+    manager.setBaseDirectory(root);
+
+    int iterations = qMax(1, parser.value("iterations").toInt());
+    QString nameWord = spec.corpus.first();
+
+    QJsonArray scenarios;
+    scenarios.append(runScenario(manager, "name", nameWord, tree, iterations));
+    scenarios.append(runScenario(manager, "metadata", "ext:txt,log size:>16KB modified:<30d", tree, iterations));
+    scenarios.append(runScenario(manager, "content", QString("\"%1\"").arg(NEEDLE), tree, iterations));
+
+    QJsonObject treeObject;
+    treeObject["root"] = root;
+    treeObject["depth"] = spec.depth;
+    treeObject["fanout"] = spec.fanout;
+    treeObject["files_per_dir"] = spec.filesPerDir;
+    treeObject["min_size"] = spec.minSize;
+    treeObject["max_size"] = spec.maxSize;
+    treeObject["seed"] = QString::number(spec.seed);
+    treeObject["files"] = tree.files;
+    treeObject["directories"] = tree.directories;
+    treeObject["bytes"] = tree.bytes;
+    treeObject["generate_ms"] = generateMsecs;
+
+    QJsonObject report;
+    report["tree"] = treeObject;
+    report["scenarios"] = scenarios;
+
+    QByteArray json = QJsonDocument(report).toJson();
+    if (parser.isSet("output")) {
+        QFile output(parser.value("output"));
+        if (!output.open(QIODevice::WriteOnly)) {
+            qCritical("Cannot write %s", qPrintable(parser.value("output")));
+            return 1;
+        }
+        output.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return 0;
+}
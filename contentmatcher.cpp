@@ -0,0 +1,272 @@
+#include "contentmatcher.h"
+#include <QFile>
+#include <cstring>
+#include <fcntl.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CONTENTMATCHER_X86 1
+#endif
+
+namespace {
+
+const qsizetype BINARY_PROBE_SIZE = 8192;
+const qsizetype STREAM_CHUNK_SIZE = 256 * 1024;
+const qsizetype REGEX_BLOCK_SIZE = 1024 * 1024;
+
+inline bool equalsEither(const unsigned char* p, const unsigned char* lo, const unsigned char* up, size_t n) {
+    for (size_t k = 0; k < n; ++k) {
+        if (p[k] != lo[k] && p[k] != up[k])
+            return false;
+    }
+    return true;
+}
+
+size_t scalarFind(const unsigned char* data, size_t size, const unsigned char* lo, const unsigned char* up, size_t n, size_t from) {
+    if (std::memcmp(lo, up, n) == 0) {
+        const void* hit = memmem(data + from, size - from, lo, n);
+        return hit ? size_t(static_cast<const unsigned char*>(hit) - data) : size_t(-1);
+    }
+
+    for (size_t i = from; i + n <= size; ++i) {
+        if ((data[i] == lo[0] || data[i] == up[0]) && equalsEither(data + i, lo, up, n))
+            return i;
+    }
+    return size_t(-1);
+}
+
+#ifdef CONTENTMATCHER_X86
+
+size_t sse2Find(const unsigned char* data, size_t size, const unsigned char* lo, const unsigned char* up, size_t n) {
+    const __m128i firstLo = _mm_set1_epi8(char(lo[0]));
+    const __m128i firstUp = _mm_set1_epi8(char(up[0]));
+    const __m128i lastLo = _mm_set1_epi8(char(lo[n - 1]));
+    const __m128i lastUp = _mm_set1_epi8(char(up[n - 1]));
+
+    size_t i = 0;
+    for (; i + n - 1 + 16 <= size; i += 16) {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + n - 1));
+        __m128i eqHead = _mm_or_si128(_mm_cmpeq_epi8(head, firstLo), _mm_cmpeq_epi8(head, firstUp));
+        __m128i eqTail = _mm_or_si128(_mm_cmpeq_epi8(tail, lastLo), _mm_cmpeq_epi8(tail, lastUp));
+        unsigned mask = unsigned(_mm_movemask_epi8(_mm_and_si128(eqHead, eqTail)));
+        while (mask) {
+            unsigned bit = unsigned(__builtin_ctz(mask));
+            if (equalsEither(data + i + bit, lo, up, n))
+                return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return scalarFind(data, size, lo, up, n, i);
+}
+
+__attribute__((target("avx2")))
+size_t avx2Find(const unsigned char* data, size_t size, const unsigned char* lo, const unsigned char* up, size_t n) {
+    const __m256i firstLo = _mm256_set1_epi8(char(lo[0]));
+    const __m256i firstUp = _mm256_set1_epi8(char(up[0]));
+    const __m256i lastLo = _mm256_set1_epi8(char(lo[n - 1]));
+    const __m256i lastUp = _mm256_set1_epi8(char(up[n - 1]));
+
+    size_t i = 0;
+    for (; i + n - 1 + 32 <= size; i += 32) {
+        __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + n - 1));
+        __m256i eqHead = _mm256_or_si256(_mm256_cmpeq_epi8(head, firstLo), _mm256_cmpeq_epi8(head, firstUp));
+        __m256i eqTail = _mm256_or_si256(_mm256_cmpeq_epi8(tail, lastLo), _mm256_cmpeq_epi8(tail, lastUp));
+        unsigned mask = unsigned(_mm256_movemask_epi8(_mm256_and_si256(eqHead, eqTail)));
+        while (mask) {
+            unsigned bit = unsigned(__builtin_ctz(mask));
+            if (equalsEither(data + i + bit, lo, up, n))
+                return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return scalarFind(data, size, lo, up, n, i);
+}
+
+#endif
+
+using FindFunction = size_t (*)(const unsigned char*, size_t, const unsigned char*, const unsigned char*, size_t);
+
+size_t portableFind(const unsigned char* data, size_t size, const unsigned char* lo, const unsigned char* up, size_t n) {
+    return scalarFind(data, size, lo, up, n, 0);
+}
+
+FindFunction selectFind() {
+#ifdef CONTENTMATCHER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return avx2Find;
+    return sse2Find;
+#else
+    return portableFind;
+#endif
+}
+
+const FindFunction findBytes = selectFind();
+
+// The dual-case byte search is exact only where the two forms differ in ASCII bytes alone.
+bool bytewiseCaseSafe(const QByteArray& lower, const QByteArray& upper) {
+    if (lower.size() != upper.size())
+        return false;
+    for (qsizetype i = 0; i < lower.size(); ++i) {
+        if (lower[i] != upper[i] && (uchar(lower[i]) >= 0x80 || uchar(upper[i]) >= 0x80))
+            return false;
+    }
+    return true;
+}
+
+}
+
+ContentMatcher::ContentMatcher()
+    : regexMode(false), valid(false) {
+}
+
+ContentMatcher::ContentMatcher(const QString& text, bool caseSensitive, bool useRegex)
+    : regexMode(useRegex), valid(!text.isEmpty()) {
+    if (regexMode) {
+        regex = QRegularExpression(text, caseSensitive ? QRegularExpression::NoPatternOption
+                                                       : QRegularExpression::CaseInsensitiveOption);
+        regex.optimize();
+        valid = valid && regex.isValid();
+        return;
+    }
+
+    if (caseSensitive) {
+        lower = text.toUtf8();
+        upper = lower;
+        return;
+    }
+
+    lower = text.toLower().toUtf8();
+    upper = text.toUpper().toUtf8();
+    if (!bytewiseCaseSafe(lower, upper)) {
+        // Comparing a multi-byte character's bytes against either case form independently would accept
+        // bytes of the two forms mixed into some third character; the regex compares whole code points.
+        regexMode = true;
+        regex = QRegularExpression(QRegularExpression::escape(text), QRegularExpression::CaseInsensitiveOption);
+        regex.optimize();
+        lower.clear();
+        upper.clear();
+    }
+}
+
+bool ContentMatcher::looksBinary(const char* data, qsizetype size) {
+    return std::memchr(data, 0, size_t(qMin(size, BINARY_PROBE_SIZE))) != nullptr;
+}
+
+bool ContentMatcher::matches(const char* data, qsizetype size) const {
+    if (!valid || size <= 0)
+        return false;
+    return regexMode ? findRegex(data, size) : findLiteral(data, size);
+}
+
+bool ContentMatcher::findLiteral(const char* data, qsizetype size) const {
+    if (size < lower.size())
+        return false;
+
+    return findBytes(reinterpret_cast<const unsigned char*>(data), size_t(size),
+                     reinterpret_cast<const unsigned char*>(lower.constData()),
+                     reinterpret_cast<const unsigned char*>(upper.constData()),
+                     size_t(lower.size())) != size_t(-1);
+}
+
+bool ContentMatcher::findRegex(const char* data, qsizetype size) const {
+    qsizetype start = 0;
+    while (start < size) {
+        qsizetype end = qMin(size, start + REGEX_BLOCK_SIZE);
+        if (end < size) {
+            const void* newline = std::memchr(data + end, '\n', size_t(size - end));
+            end = newline ? static_cast<const char*>(newline) - data + 1 : size;
+        }
+
+        if (regex.match(QString::fromUtf8(data + start, end - start)).hasMatch())
+            return true;
+        start = end;
+    }
+    return false;
+}
+
+bool ContentMatcher::matchesFile(const QString& filePath) const {
+    if (!valid)
+        return false;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    if (file.size() <= 0)
+        return false;
+
+    // Read rather than mapped: a file truncated while it is searched (a rotated log, an editor saving)
+    // would raise SIGBUS on the next mapped page, where read() just returns less.
+    ::posix_fadvise(file.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    Stream stream(*this);
+    QByteArray buffer(STREAM_CHUNK_SIZE, Qt::Uninitialized);
+    qint64 bytesRead;
+    while ((bytesRead = file.read(buffer.data(), buffer.size())) > 0) {
+        if (!stream.feed(buffer.constData(), bytesRead))
+            break;
+    }
+    return stream.finish();
+}
+
+ContentMatcher::Stream::Stream(const ContentMatcher& matcher)
+    : matcher(matcher), matched(false), checkedBinary(false), binary(false) {
+}
+
+bool ContentMatcher::Stream::feed(const char* data, qsizetype size) {
+    if (matched || binary || size <= 0)
+        return !matched && !binary;
+
+    if (!checkedBinary) {
+        checkedBinary = true;
+        binary = looksBinary(data, size);
+        if (binary)
+            return false;
+    }
+
+    if (matcher.regexMode) {
+        const char* end = data + size;
+        const char* lastNewline = static_cast<const char*>(memrchr(data, '\n', size_t(size)));
+        if (!lastNewline && carry.size() + size < REGEX_BLOCK_SIZE) {
+            carry.append(data, size);
+            return true;
+        }
+
+        const char* split = lastNewline ? lastNewline + 1 : end;
+        carry.append(data, split - data);
+        matched = matcher.findRegex(carry.constData(), carry.size());
+        carry = QByteArray(split, end - split);
+        return !matched;
+    }
+
+    qsizetype overlap = matcher.overlap();
+    if (!carry.isEmpty()) {
+        QByteArray boundary = carry + QByteArray::fromRawData(data, qMin(size, overlap));
+        if (matcher.findLiteral(boundary.constData(), boundary.size())) {
+            matched = true;
+            return false;
+        }
+    }
+
+    if (matcher.findLiteral(data, size)) {
+        matched = true;
+        return false;
+    }
+
+    if (size >= overlap) {
+        carry = QByteArray(data + size - overlap, overlap);
+    } else {
+        carry.append(data, size);
+        carry = carry.right(overlap);
+    }
+    return true;
+}
+
+bool ContentMatcher::Stream::finish() {
+    if (!matched && !binary && matcher.regexMode && !carry.isEmpty())
+        matched = matcher.findRegex(carry.constData(), carry.size());
+    carry.clear();
+    return matched;
+}
@@ -0,0 +1,52 @@
+#ifndef CONTENTMATCHER_H
+#define CONTENTMATCHER_H
+
+#include <QByteArray>
+#include <QRegularExpression>
+#include <QString>
+
+class ContentMatcher {
+public:
+    ContentMatcher();
+    ContentMatcher(const QString& text, bool caseSensitive, bool useRegex);
+
+    bool isValid() const { return valid; }
+
+    bool matches(const char* data, qsizetype size) const;
+
+    bool matchesFile(const QString& filePath) const;
+
+    qsizetype overlap() const { return regexMode ? 0 : lower.size() - 1; }
+
+    static bool looksBinary(const char* data, qsizetype size);
+
+    class Stream {
+    public:
+        explicit Stream(const ContentMatcher& matcher);
+
+        bool feed(const char* data, qsizetype size);
+
+        bool finish();
+
+        bool found() const { return matched; }
+
+    private:
+        const ContentMatcher& matcher;
+        QByteArray carry;
+        bool matched;
+        bool checkedBinary;
+        bool binary;
+    };
+
+private:
+    QByteArray lower;
+    QByteArray upper;
+    QRegularExpression regex;
+    bool regexMode;
+    bool valid;
+
+    bool findLiteral(const char* data, qsizetype size) const;
+    bool findRegex(const char* data, qsizetype size) const;
+};
+
+#endif
@@ -0,0 +1,1188 @@
+#include "directorymodel.h"
+#include "foldersizescanner.h"
+#include "iconcache.h"
+#include "metadataloader.h"
+#include "mounttable.h"
+#include "statxbatch.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileSystemModel>
+#include <QLocale>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QSettings>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <utility>
+#include <fcntl.h>
+#include <linux/ioprio.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+Q_LOGGING_CATEGORY(lcListing, "explosion.listing", QtInfoMsg)
+
+namespace {
+
+const size_t FIRST_DIRENT_BUFFER_SIZE = 32 * 1024;
+const size_t DIRENT_BUFFER_SIZE = 256 * 1024;
+const int FIRST_BATCH_SIZE = 256;
+const int BATCH_SIZE = 4096;
+const int DRAIN_INTERVAL_MS = 30;
+const quint16 NO_SUFFIX = 0;
+const int DEFAULT_CACHE_BUDGET_MB = 64;
+const int PREFETCH_STAT_LIMIT = FIRST_BATCH_SIZE;
+const qptrdiff PARALLEL_SORT_MIN_CHUNK = 32 * 1024;
+const size_t STAT_WINDOW = 256;
+const size_t PARALLEL_STAT_MIN_CHUNK = 4096;
+
+template <typename T>
+qint64 bytesOf(const std::vector<T>& values) {
+    return qint64(values.capacity() * sizeof(T));
+}
+
+inline char foldAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? char(c + ('a' - 'A')) : c;
+}
+
+int compareNames(const char* a, qsizetype aLength, const char* b, qsizetype bLength) {
+    qsizetype length = std::min(aLength, bLength);
+    for (qsizetype i = 0; i < length; ++i) {
+        char x = foldAscii(a[i]);
+        char y = foldAscii(b[i]);
+        if (x != y)
+            return uchar(x) < uchar(y) ? -1 : 1;
+    }
+    if (aLength != bLength)
+        return aLength < bLength ? -1 : 1;
+    return std::memcmp(a, b, size_t(length));
+}
+
+// Case-folded name with every digit run replaced by its significant-digit count and digits, so a plain
+// byte compare puts "file9" before "file10". Counts of nine or more spill into extra '9' bytes to stay
+// ordered; no byte is NUL, so keys are stored NUL-terminated like the names.
+void appendNaturalKey(QByteArray& out, const char* name, qsizetype length) {
+    QByteArray folded;
+    for (qsizetype i = 0; i < length; ++i) {
+        if (uchar(name[i]) >= 0x80) {
+            folded = QString::fromUtf8(name, length).toCaseFolded().toUtf8();
+            name = folded.constData();
+            length = folded.size();
+            break;
+        }
+    }
+
+    for (qsizetype i = 0; i < length;) {
+        if (name[i] < '0' || name[i] > '9') {
+            out.append(foldAscii(name[i++]));
+            continue;
+        }
+
+        qsizetype significant = i;
+        while (i < length && name[i] >= '0' && name[i] <= '9')
+            ++i;
+        while (significant < i && name[significant] == '0')
+            ++significant;
+
+        qsizetype digits = i - significant;
+        for (; digits >= 9; digits -= 9)
+            out.append('9');
+        out.append(char('0' + digits));
+        out.append(name + significant, i - significant);
+    }
+    out.append('\0');
+}
+
+// Runs task(0..count-1) on the global pool. Tasks the pool cannot take right away run on the caller,
+// so a busy pool never leaves the GUI thread waiting.
+void runParallel(int count, const std::function<void(int)>& task) {
+    QSemaphore done;
+    int started = 0;
+    for (int i = 1; i < count; ++i) {
+        if (QThreadPool::globalInstance()->tryStart([&task, &done, i]() { task(i); done.release(); }))
+            ++started;
+        else
+            task(i);
+    }
+    task(0);
+    done.acquire(started);
+}
+
+template <typename Iterator, typename Compare>
+void parallelSort(Iterator first, Iterator last, Compare less) {
+    qptrdiff count = last - first;
+    int chunks = int(std::min<qptrdiff>(QThread::idealThreadCount(), count / PARALLEL_SORT_MIN_CHUNK));
+    if (chunks < 2) {
+        std::sort(first, last, less);
+        return;
+    }
+
+    std::vector<Iterator> bounds;
+    for (int i = 0; i <= chunks; ++i)
+        bounds.push_back(first + count * i / chunks);
+
+    runParallel(chunks, [&](int i) { std::sort(bounds[i], bounds[i + 1], less); });
+    for (int width = 1; width < chunks; width *= 2) {
+        runParallel((chunks + 2 * width - 1) / (2 * width), [&](int merge) {
+            int low = merge * 2 * width;
+            std::inplace_merge(bounds[low], bounds[std::min(low + width, chunks)],
+                               bounds[std::min(low + 2 * width, chunks)], less);
+        });
+    }
+}
+
+}
+
+struct ListingBatch {
+    QByteArray names;
+    QByteArray keys;
+    std::vector<quint8> types;
+};
+
+struct ListingJob {
+    QString path;
+    bool replace = false;
+    std::atomic<bool> cancelled{false};
+    QMutex mutex;
+    std::vector<ListingBatch> pending;
+    bool finished = false;
+};
+
+// Cancelling the prefetch cancels its listing, so one flag stops both the walk and the current folder.
+struct PrefetchJob {
+    QStringList paths;
+    QVector<qint64> cachedMtimes;
+    ListingJob listing;
+};
+
+struct PrefetchedListing {
+    QString path;
+    quint64 device;
+    quint64 inode;
+    qint64 mtimeNsecs;
+    std::vector<ListingBatch> batches;
+};
+
+namespace {
+
+quint8 entryTypeOf(unsigned char direntType) {
+    switch (direntType) {
+        case DT_REG: return DirectoryModel::FileType;
+        case DT_DIR: return DirectoryModel::DirectoryType;
+        case DT_LNK: return DirectoryModel::SymlinkType;
+        case DT_UNKNOWN: return DirectoryModel::UnknownType;
+        default: return DirectoryModel::OtherType;
+    }
+}
+
+// Runs on the listing pool; hands batches to the GUI thread through ListingJob::pending.
+void listDirectory(ListingJob& job, const std::function<void(bool)>& published) {
+    int fd = ::open(QFile::encodeName(job.path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        std::vector<char> buffer(FIRST_DIRENT_BUFFER_SIZE);
+        ListingBatch batch;
+        int limit = FIRST_BATCH_SIZE;
+        bool first = true;
+
+        auto publish = [&]() {
+            {
+                QMutexLocker locker(&job.mutex);
+                job.pending.push_back(std::move(batch));
+            }
+            batch = ListingBatch();
+            published(first);
+            first = false;
+            limit = BATCH_SIZE;
+        };
+
+        while (!job.cancelled.load(std::memory_order_relaxed)) {
+            long got = ::syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+            if (got <= 0)
+                break;
+
+            // linux_dirent64: d_ino (8), d_off (8), d_reclen (2), d_type (1), d_name.
+            for (long offset = 0; offset < got;) {
+                const char* record = buffer.data() + offset;
+                unsigned short recordLength;
+                std::memcpy(&recordLength, record + 16, sizeof(recordLength));
+                const char* name = record + 19;
+                offset += recordLength;
+
+                if (name[0] == '.')
+                    continue;
+
+                qsizetype length = qsizetype(std::strlen(name));
+                batch.names.append(name, length + 1);
+                appendNaturalKey(batch.keys, name, length);
+                batch.types.push_back(entryTypeOf(uchar(record[18])));
+                if (int(batch.types.size()) >= limit)
+                    publish();
+            }
+
+            if (buffer.size() < DIRENT_BUFFER_SIZE)
+                buffer.resize(DIRENT_BUFFER_SIZE);
+        }
+        ::close(fd);
+
+        if (!batch.types.empty() && !job.cancelled.load())
+            publish();
+    }
+
+    QMutexLocker locker(&job.mutex);
+    job.finished = true;
+}
+
+// Stats the first screenful so the kernel (and NFS attribute cache) has it when the folder is opened.
+void warmMetadata(const QString& path, const std::vector<ListingBatch>& batches, const std::atomic<bool>& cancelled) {
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    int remaining = PREFETCH_STAT_LIMIT;
+    for (const ListingBatch& batch : batches) {
+        const char* name = batch.names.constData();
+        for (size_t i = 0; i < batch.types.size() && remaining > 0; ++i, --remaining) {
+            if (cancelled.load(std::memory_order_relaxed))
+                break;
+            struct statx stx;
+            ::statx(fd, name, AT_STATX_SYNC_AS_STAT, STATX_TYPE | STATX_SIZE | STATX_MTIME, &stx);
+            name += std::strlen(name) + 1;
+        }
+    }
+    ::close(fd);
+}
+
+void prefetchDirectories(PrefetchJob& job, const std::function<void(std::shared_ptr<PrefetchedListing>)>& deliver) {
+    // ioprio_set(2) has no glibc wrapper; with IOPRIO_WHO_PROCESS a zero id means the calling thread.
+    ::syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0));
+
+    ListingJob& listing = job.listing;
+    for (qsizetype i = 0; i < job.paths.size() && !listing.cancelled.load(); ++i) {
+        struct stat st;
+        if (::stat(QFile::encodeName(job.paths[i]).constData(), &st) != 0 || !S_ISDIR(st.st_mode))
+            continue;
+        qint64 mtime = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        if (mtime == job.cachedMtimes[i])
+            continue;
+
+        listing.path = job.paths[i];
+        listDirectory(listing, [](bool) {});
+
+        auto result = std::make_shared<PrefetchedListing>();
+        result->path = job.paths[i];
+        result->device = quint64(st.st_dev);
+        result->inode = quint64(st.st_ino);
+        result->mtimeNsecs = mtime;
+        {
+            QMutexLocker locker(&listing.mutex);
+            result->batches.swap(listing.pending);
+            listing.finished = false;
+        }
+        if (listing.cancelled.load())
+            break;
+
+        warmMetadata(result->path, result->batches, listing.cancelled);
+        deliver(result);
+    }
+}
+
+}
+
+DirectoryModel::DirectoryModel(QObject* parent)
+    : QAbstractTableModel(parent), rootFd(-1), rootDevice(0), rootInode(0), rootMtimeNsecs(0), slowMount(false),
+      sortedRowCount(0),
+      sortColumn(0), sortOrder(Qt::AscendingOrder),
+      pool(new QThreadPool(this)), drainTimer(new QTimer(this)), prefetchPool(new QThreadPool(this)),
+      metadata(new MetadataLoader(this)), pendingStats(0), viewFields(SizeField | ModifiedField),
+      statFields(viewFields), folderSizes(new FolderSizeScanner(this)), showFolderSizes(false), cacheHits(0), cacheStaleHits(0), cacheMisses(0), prefetchedListings(0) {
+    pool->setMaxThreadCount(2);
+    drainTimer->setInterval(DRAIN_INTERVAL_MS);
+    connect(drainTimer, &QTimer::timeout, this, &DirectoryModel::drainListing);
+
+    prefetchPool->setMaxThreadCount(1);
+    prefetchPool->setThreadPriority(QThread::LowestPriority);
+
+    connect(metadata, &MetadataLoader::resultsReady, this, &DirectoryModel::applyMetadata);
+    connect(folderSizes, &FolderSizeScanner::sizesUpdated, this, &DirectoryModel::applyFolderSizes);
+    connect(folderSizes, &FolderSizeScanner::finished, this, &DirectoryModel::folderSizesFinished);
+    connect(&IconCache::shared(), &IconCache::fileIconsChanged, this, [this]() {
+        if (rowCount() > 0)
+            emit dataChanged(index(0, 0), index(rowCount() - 1, 0), {Qt::DecorationRole});
+    });
+
+    QSettings settings("Explosion", "Explosion");
+    setCacheBudget(settings.value("listing/cacheBudgetMB", DEFAULT_CACHE_BUDGET_MB).toLongLong() * 1024 * 1024);
+    showFolderSizes = settings.value("view/folderSizes", false).toBool();
+
+    suffixTypes.append(QStringLiteral("File"));
+}
+
+DirectoryModel::~DirectoryModel() {
+    cancelListing();
+    cancelPrefetch();
+    pool->waitForDone();
+    prefetchPool->waitForDone();
+    if (rootFd >= 0)
+        ::close(rootFd);
+}
+
+void DirectoryModel::setRootPath(const QString& path) {
+    bool complete = !job;
+    cancelListing();
+    cancelPrefetch();
+    folderSizes->cancel();
+
+    beginResetModel();
+    if (complete)
+        storeSnapshot();
+    clearEntries();
+
+    root = QDir::cleanPath(path);
+    MountInfo mount = MountTable::read().mountFor(root);
+    slowMount = mount.slow;
+    metadata->setDirectory(root, mount);
+    rootDevice = 0;
+    rootInode = 0;
+    rootMtimeNsecs = 0;
+    statFields = viewFields;
+
+    // Opening a folder on a hung mount blocks too, so there it is left to the listing thread.
+    if (!slowMount) {
+        rootFd = ::open(QFile::encodeName(root).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+        struct stat st;
+        if (rootFd >= 0 && ::fstat(rootFd, &st) == 0) {
+            rootDevice = quint64(st.st_dev);
+            rootInode = quint64(st.st_ino);
+            rootMtimeNsecs = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        }
+    }
+
+    bool stale = false;
+    bool restored = rootAvailable() && restoreSnapshot(&stale);
+    if (restored) {
+        rebuildRows();
+        sortRows();
+    }
+    endResetModel();
+
+    if (!rootAvailable())
+        return;
+    if (!restored)
+        startListing(false);
+    else if (stale)
+        startListing(true);
+    else
+        finishListing();
+}
+
+qint64 DirectoryModel::ListingSnapshot::cost() const {
+    return qint64(sizeof(ListingSnapshot)) + nameArena.capacity() + bytesOf(nameOffsets) + keyArena.capacity() +
+           bytesOf(keyOffsets) + bytesOf(nameOrder) + bytesOf(types) + bytesOf(suffixIds) + bytesOf(sizes) +
+           bytesOf(modified);
+}
+
+void DirectoryModel::setCacheBudget(qint64 bytes) {
+    cache.setMaxCost(qMax<qint64>(0, bytes));
+}
+
+DirectoryModel::CacheStats DirectoryModel::cacheStats() const {
+    return {cacheHits, cacheStaleHits, cacheMisses, prefetchedListings, qint64(cache.totalCost()), cache.size()};
+}
+
+void DirectoryModel::prefetch(const QStringList& paths) {
+    cancelPrefetch();
+
+    // Prefetching would only add stalled threads to a slow mount.
+    MountTable mounts = MountTable::read();
+    auto current = std::make_shared<PrefetchJob>();
+    for (const QString& path : paths) {
+        QString cleaned = QDir::cleanPath(path);
+        if (cleaned == root || current->paths.contains(cleaned) || mounts.mountFor(cleaned).slow)
+            continue;
+        const ListingSnapshot* cached = cache.object(cleaned);
+        current->paths.append(cleaned);
+        current->cachedMtimes.append(cached ? cached->mtimeNsecs : -1);
+    }
+    if (current->paths.isEmpty())
+        return;
+
+    prefetchJob = current;
+    prefetchPool->start([this, current]() {
+        prefetchDirectories(*current, [this, current](std::shared_ptr<PrefetchedListing> listing) {
+            QMetaObject::invokeMethod(this, [this, current, listing]() {
+                if (prefetchJob == current)
+                    storePrefetched(*listing);
+            }, Qt::QueuedConnection);
+        });
+    });
+}
+
+void DirectoryModel::cancelPrefetch() {
+    if (!prefetchJob)
+        return;
+
+    prefetchJob->listing.cancelled = true;
+    prefetchJob.reset();
+}
+
+void DirectoryModel::storePrefetched(const PrefetchedListing& listing) {
+    if (listing.path == root)
+        return;
+
+    auto* snapshot = new ListingSnapshot;
+    snapshot->device = listing.device;
+    snapshot->inode = listing.inode;
+    snapshot->mtimeNsecs = listing.mtimeNsecs;
+    snapshot->nameOffsets.assign(1, 0);
+    snapshot->keyOffsets.assign(1, 0);
+    for (const ListingBatch& batch : listing.batches) {
+        const char* name = batch.names.constData();
+        const char* key = batch.keys.constData();
+        for (quint8 type : batch.types) {
+            qsizetype length = qsizetype(std::strlen(name));
+            snapshot->nameArena.append(name, length + 1);
+            snapshot->nameOffsets.push_back(quint32(snapshot->nameArena.size()));
+            qsizetype keyLength = qsizetype(std::strlen(key));
+            snapshot->keyArena.append(key, keyLength + 1);
+            snapshot->keyOffsets.push_back(quint32(snapshot->keyArena.size()));
+            key += keyLength + 1;
+            snapshot->types.push_back(type);
+            snapshot->suffixIds.push_back(internSuffix(name, length));
+            name += length + 1;
+        }
+    }
+    snapshot->sizes.assign(snapshot->types.size(), -1);
+    snapshot->modified.assign(snapshot->types.size(), 0);
+
+    ++prefetchedListings;
+    qCDebug(lcListing) << "Prefetched" << listing.path << snapshot->types.size() << "entries";
+    cache.insert(listing.path, snapshot, snapshot->cost());
+}
+
+void DirectoryModel::storeSnapshot() {
+    if (root.isEmpty() || !rootAvailable())
+        return;
+
+    auto* snapshot = new ListingSnapshot;
+    snapshot->device = rootDevice;
+    snapshot->inode = rootInode;
+    snapshot->mtimeNsecs = rootMtimeNsecs;
+    snapshot->nameArena = std::move(nameArena);
+    snapshot->nameOffsets = std::move(nameOffsets);
+    snapshot->keyArena = std::move(keyArena);
+    snapshot->keyOffsets = std::move(keyOffsets);
+    snapshot->nameOrder = std::move(nameOrder);
+    snapshot->types = std::move(types);
+    snapshot->suffixIds = std::move(suffixIds);
+    snapshot->sizes = std::move(sizes);
+    snapshot->modified = std::move(modified);
+
+    // QCache deletes the snapshot itself when it exceeds the whole budget.
+    cache.insert(root, snapshot, snapshot->cost());
+}
+
+bool DirectoryModel::restoreSnapshot(bool* stale) {
+    ListingSnapshot* snapshot = cache.take(root);
+    bool sameFolder = snapshot && (slowMount || (snapshot->device == rootDevice && snapshot->inode == rootInode));
+    if (!sameFolder) {
+        delete snapshot;
+        ++cacheMisses;
+        qCDebug(lcListing) << "Listing cache miss" << root << "hits" << cacheHits << "misses" << cacheMisses;
+        return false;
+    }
+
+    // Without a stat of the folder a slow mount cannot validate the snapshot; it is shown while relisting.
+    *stale = slowMount || snapshot->mtimeNsecs != rootMtimeNsecs;
+    if (*stale)
+        ++cacheStaleHits;
+    else
+        ++cacheHits;
+    qCDebug(lcListing) << "Listing cache" << (*stale ? "stale hit" : "hit") << root
+                       << "hits" << cacheHits << "stale" << cacheStaleHits << "misses" << cacheMisses;
+
+    nameArena = std::move(snapshot->nameArena);
+    nameOffsets = std::move(snapshot->nameOffsets);
+    keyArena = std::move(snapshot->keyArena);
+    keyOffsets = std::move(snapshot->keyOffsets);
+    nameOrder = std::move(snapshot->nameOrder);
+    types = std::move(snapshot->types);
+    suffixIds = std::move(snapshot->suffixIds);
+    sizes = std::move(snapshot->sizes);
+    modified = std::move(snapshot->modified);
+    delete snapshot;
+
+    // Entry metadata may have changed without touching the folder's mtime; re-stat rows as they are shown.
+    statStates.assign(types.size(), NotStatted);
+    return true;
+}
+
+void DirectoryModel::clearEntries() {
+    if (rootFd >= 0)
+        ::close(rootFd);
+    rootFd = -1;
+    resetEntries();
+}
+
+void DirectoryModel::resetEntries() {
+    nameArena.clear();
+    nameOffsets.assign(1, 0);
+    keyArena.clear();
+    keyOffsets.assign(1, 0);
+    nameOrder.clear();
+    nameRanks.clear();
+    types.clear();
+    suffixIds.clear();
+    statStates.clear();
+    sizes.clear();
+    modified.clear();
+    rows.clear();
+    sortedRowCount = 0;
+    metadata->reset();
+    pendingStats = 0;
+    scannedFolders.clear();
+    folderBytes.clear();
+    folderComplete.clear();
+    folderPartial.clear();
+}
+
+void DirectoryModel::startListing(bool replace) {
+    auto current = std::make_shared<ListingJob>();
+    current->path = root;
+    current->replace = replace;
+    job = current;
+
+    pool->start([this, current]() {
+        listDirectory(*current, [this, current](bool first) {
+            // The first screenful is drained at once; later batches ride the timer.
+            if (first)
+                QMetaObject::invokeMethod(this, [this]() { drainListing(); }, Qt::QueuedConnection);
+        });
+        QMetaObject::invokeMethod(this, [this]() { drainListing(); }, Qt::QueuedConnection);
+    });
+    drainTimer->start();
+}
+
+void DirectoryModel::cancelListing() {
+    if (!job)
+        return;
+
+    job->cancelled = true;
+    job.reset();
+    drainTimer->stop();
+}
+
+void DirectoryModel::drainListing() {
+    std::shared_ptr<ListingJob> current = job;
+    if (!current)
+        return;
+
+    std::vector<ListingBatch> batches;
+    bool done;
+    {
+        QMutexLocker locker(&current->mutex);
+        if (current->replace && !current->finished)
+            return;
+        batches.swap(current->pending);
+        done = current->finished;
+    }
+
+    // A revalidation keeps showing the cached listing and swaps in the fresh one in a single reset.
+    if (current->replace) {
+        drainTimer->stop();
+        job.reset();
+        beginResetModel();
+        resetEntries();
+        for (const ListingBatch& batch : batches)
+            appendBatch(batch);
+        rebuildRows();
+        sortRows();
+        endResetModel();
+        finishListing();
+        return;
+    }
+
+    quint32 firstNew = quint32(types.size());
+    for (const ListingBatch& batch : batches)
+        appendBatch(batch);
+
+    quint32 count = quint32(types.size());
+    if (firstNew < count) {
+        int first = int(rows.size());
+        beginInsertRows(QModelIndex(), first, first + int(count - firstNew) - 1);
+        for (quint32 entry = firstNew; entry < count; ++entry)
+            rows.push_back(entry);
+        endInsertRows();
+    }
+
+    if (done) {
+        drainTimer->stop();
+        job.reset();
+        applySort();
+        finishListing();
+    }
+}
+
+void DirectoryModel::finishListing() {
+    if (showFolderSizes && !slowMount)
+        startFolderSizes();
+    emit directoryLoaded(root);
+}
+
+void DirectoryModel::setFolderSizesEnabled(bool enabled) {
+    if (enabled == showFolderSizes)
+        return;
+
+    showFolderSizes = enabled;
+    if (enabled) {
+        if (rootFd >= 0 && !slowMount && !job)
+            startFolderSizes();
+        return;
+    }
+
+    folderSizes->cancel();
+    scannedFolders.clear();
+    folderBytes.clear();
+    folderComplete.clear();
+    folderPartial.clear();
+    if (!rows.empty())
+        emit dataChanged(index(0, 1), index(int(rows.size()) - 1, 1), {Qt::DisplayRole, Qt::EditRole});
+    if (sortColumn == 1) {
+        sortedRowCount = 0;
+        applySort();
+    }
+}
+
+void DirectoryModel::startFolderSizes() {
+    // Rows are already sorted, so the folders on screen first are measured first.
+    QStringList names;
+    scannedFolders.clear();
+    for (quint32 entry : rows) {
+        if (entryIsDir(entry)) {
+            scannedFolders.push_back(entry);
+            names.append(nameString(entry));
+        }
+    }
+    folderBytes.assign(types.size(), -1);
+    folderComplete.assign(types.size(), 0);
+    folderPartial.assign(types.size(), 0);
+    folderSizes->start(root, names);
+}
+
+void DirectoryModel::applyFolderSizes(const QVector<FolderSize>& updates) {
+    if (folderBytes.empty())
+        return;
+
+    for (const FolderSize& update : updates) {
+        if (size_t(update.folder) >= scannedFolders.size())
+            continue;
+        quint32 entry = scannedFolders[size_t(update.folder)];
+        folderBytes[entry] = update.bytes;
+        folderComplete[entry] = update.complete;
+        folderPartial[entry] = update.partial;
+    }
+    // Views repaint only the cells they show, so one column-wide change is cheaper than a signal per row.
+    emit dataChanged(index(0, 1), index(int(rows.size()) - 1, 1), {Qt::DisplayRole, Qt::EditRole});
+}
+
+void DirectoryModel::folderSizesFinished() {
+    // Totals arrive after the listing was sorted; a size sort has to place folders again once they settle.
+    if (sortColumn == 1) {
+        sortedRowCount = 0;
+        applySort();
+    }
+}
+
+qint64 DirectoryModel::folderSizeOf(quint32 entry) const {
+    if (entry < folderBytes.size() && folderBytes[entry] >= 0)
+        return folderBytes[entry];
+    return sizes[entry];
+}
+
+void DirectoryModel::appendBatch(const ListingBatch& batch) {
+    const char* name = batch.names.constData();
+    const char* key = batch.keys.constData();
+    for (quint8 type : batch.types) {
+        qsizetype length = qsizetype(std::strlen(name));
+        qsizetype keyLength = qsizetype(std::strlen(key));
+        appendEntry(name, length, key, keyLength, type);
+        name += length + 1;
+        key += keyLength + 1;
+    }
+}
+
+void DirectoryModel::appendEntry(const char* name, qsizetype length, const char* key, qsizetype keyLength, quint8 type) {
+    nameArena.append(name, length);
+    nameArena.append('\0');
+    nameOffsets.push_back(quint32(nameArena.size()));
+    keyArena.append(key, keyLength);
+    keyArena.append('\0');
+    keyOffsets.push_back(quint32(keyArena.size()));
+    types.push_back(type);
+    suffixIds.push_back(internSuffix(name, length));
+    statStates.push_back(NotStatted);
+    sizes.push_back(-1);
+    modified.push_back(0);
+}
+
+quint16 DirectoryModel::internSuffix(const char* name, qsizetype length) {
+    const char* dot = static_cast<const char*>(std::memrchr(name, '.', size_t(length)));
+    if (!dot || dot == name || dot == name + length - 1)
+        return NO_SUFFIX;
+
+    QByteArray suffix(dot + 1, length - (dot + 1 - name));
+    for (char& c : suffix)
+        c = foldAscii(c);
+
+    auto it = suffixLookup.constFind(suffix);
+    if (it != suffixLookup.constEnd())
+        return it.value();
+    if (suffixTypes.size() > 0xFFFF)
+        return NO_SUFFIX;
+
+    quint16 id = quint16(suffixTypes.size());
+    suffixTypes.append(QString::fromUtf8(suffix).toUpper() + QStringLiteral(" File"));
+    suffixLookup.insert(suffix, id);
+    return id;
+}
+
+void DirectoryModel::ensureStat(quint32 entry) const {
+    if (statStates[entry] != NotStatted)
+        return;
+
+    if (slowMount) {
+        statStates[entry] = StatPending;
+        ++pendingStats;
+        metadata->request(entry, nameAt(entry), statMask());
+        return;
+    }
+
+    struct statx stx;
+    if (rootFd < 0 || ::statx(rootFd, nameAt(entry), AT_STATX_SYNC_AS_STAT, statMask(), &stx) != 0) {
+        statStates[entry] = StatFailed;
+        return;
+    }
+
+    applyStat(entry, stx.stx_mode, qint64(stx.stx_size),
+              qint64(stx.stx_mtime.tv_sec) * 1000 + stx.stx_mtime.tv_nsec / 1000000);
+}
+
+// Views paint top-down, so a window starting at the first row asked for covers the screen in one batch.
+void DirectoryModel::statRows(size_t firstRow) const {
+    std::vector<quint32> entries;
+    size_t end = std::min(rows.size(), firstRow + STAT_WINDOW);
+    for (size_t row = firstRow; row < end; ++row) {
+        if (statStates[rows[row]] == NotStatted)
+            entries.push_back(rows[row]);
+    }
+    statEntries(entries);
+}
+
+// Local folders stat on the calling thread, split across the global pool for large batches: with the inodes
+// cached, plain statx() is cheaper than queueing through io_uring. Slow mounts go through the loader.
+void DirectoryModel::statEntries(const std::vector<quint32>& entries) const {
+    if (slowMount) {
+        for (quint32 entry : entries)
+            ensureStat(entry);
+        return;
+    }
+
+    size_t count = entries.size();
+    if (count == 0)
+        return;
+    if (rootFd < 0) {
+        for (quint32 entry : entries)
+            statStates[entry] = StatFailed;
+        return;
+    }
+
+    std::vector<const char*> names(count);
+    for (size_t i = 0; i < count; ++i)
+        names[i] = nameAt(entries[i]);
+    std::vector<struct statx> stats(count);
+    std::vector<int> errors(count);
+    unsigned int mask = statMask();
+
+    int chunks = int(std::min<size_t>(size_t(QThread::idealThreadCount()), count / PARALLEL_STAT_MIN_CHUNK));
+    if (chunks < 2) {
+        statxBatch(rootFd, names.data(), count, mask, stats.data(), errors.data(), StatxDirect);
+    } else {
+        runParallel(chunks, [&](int chunk) {
+            size_t first = count * size_t(chunk) / size_t(chunks);
+            size_t last = count * size_t(chunk + 1) / size_t(chunks);
+            statxBatch(rootFd, names.data() + first, last - first, mask, stats.data() + first, errors.data() + first,
+                       StatxDirect);
+        });
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (errors[i] != 0) {
+            statStates[entries[i]] = StatFailed;
+            continue;
+        }
+        const struct statx& stx = stats[i];
+        applyStat(entries[i], stx.stx_mode, qint64(stx.stx_size),
+                  qint64(stx.stx_mtime.tv_sec) * 1000 + stx.stx_mtime.tv_nsec / 1000000);
+    }
+}
+
+unsigned int DirectoryModel::statMask() const {
+    return STATX_TYPE | ((statFields & SizeField) ? STATX_SIZE : 0) | ((statFields & ModifiedField) ? STATX_MTIME : 0);
+}
+
+bool DirectoryModel::requireFields(int fields) const {
+    if ((fields & ~statFields) == 0)
+        return false;
+
+    // Entries stat'ed without these fields hold values the file system may not have revalidated.
+    statFields |= fields;
+    for (quint8& state : statStates) {
+        if (state == Statted)
+            state = NotStatted;
+    }
+    return true;
+}
+
+void DirectoryModel::setMetadataFields(int fields) {
+    viewFields = fields;
+    if (requireFields(fields) && !rows.empty())
+        emit dataChanged(index(0, 1), index(int(rows.size()) - 1, 3));
+}
+
+void DirectoryModel::applyStat(quint32 entry, quint32 mode, qint64 size, qint64 modifiedMsecs) const {
+    statStates[entry] = Statted;
+    sizes[entry] = size;
+    modified[entry] = modifiedMsecs;
+    if (types[entry] == UnknownType)
+        types[entry] = S_ISDIR(mode) ? DirectoryType : S_ISREG(mode) ? FileType : OtherType;
+    else if (types[entry] == SymlinkType && S_ISDIR(mode))
+        types[entry] = DirectoryType;
+}
+
+void DirectoryModel::applyMetadata(const QVector<MetadataResult>& results) {
+    bool resolved = false;
+    for (const MetadataResult& result : results) {
+        quint32 entry = result.entry;
+        if (entry >= statStates.size() || (statStates[entry] != StatPending && statStates[entry] != StatTimedOut))
+            continue;
+        if (statStates[entry] == StatPending)
+            --pendingStats;
+
+        switch (result.status) {
+            case MetadataResult::Resolved:
+                applyStat(entry, result.mode, result.size, result.modifiedMsecs);
+                resolved = true;
+                break;
+            case MetadataResult::Failed:
+                statStates[entry] = StatFailed;
+                break;
+            case MetadataResult::TimedOut:
+                statStates[entry] = StatTimedOut;
+                break;
+        }
+    }
+
+    if (rows.empty())
+        return;
+    // Resolving a symlink can turn it into a folder, so the icon and type columns change too.
+    emit dataChanged(index(0, 0), index(int(rows.size()) - 1, 3));
+
+    // A metadata sort placed pending rows by placeholder values; sort again once they have all arrived.
+    if (resolved && pendingStats == 0 && !job && (sortColumn == 1 || sortColumn == 3)) {
+        sortedRowCount = 0;
+        applySort();
+    }
+}
+
+bool DirectoryModel::entryIsDir(quint32 entry) const {
+    if (types[entry] == UnknownType || types[entry] == SymlinkType)
+        ensureStat(entry);
+    return types[entry] == DirectoryType;
+}
+
+void DirectoryModel::rebuildRows() {
+    rows.clear();
+    sortedRowCount = 0;
+    quint32 count = quint32(types.size());
+    rows.reserve(count);
+
+    for (quint32 entry = 0; entry < count; ++entry)
+        rows.push_back(entry);
+}
+
+void DirectoryModel::sort(int column, Qt::SortOrder order) {
+    if (column != sortColumn || order != sortOrder)
+        sortedRowCount = 0;
+    sortColumn = column;
+    sortOrder = order;
+    applySort();
+}
+
+void DirectoryModel::applySort() {
+    emit layoutAboutToBeChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+
+    QModelIndexList persistent = persistentIndexList();
+    std::vector<quint32> persistentEntries;
+    persistentEntries.reserve(size_t(persistent.size()));
+    for (const QModelIndex& index : std::as_const(persistent))
+        persistentEntries.push_back(entryAt(index));
+
+    sortRows();
+
+    std::vector<int> rowOfEntry(types.size(), -1);
+    for (size_t row = 0; row < rows.size(); ++row)
+        rowOfEntry[rows[row]] = int(row);
+
+    QModelIndexList updated;
+    updated.reserve(persistent.size());
+    for (qsizetype i = 0; i < persistent.size(); ++i)
+        updated.append(index(rowOfEntry[persistentEntries[size_t(i)]], persistent[i].column()));
+    changePersistentIndexList(persistent, updated);
+
+    emit layoutChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+}
+
+void DirectoryModel::sortRows() {
+    size_t sorted = std::min(sortedRowCount, rows.size());
+
+    // Sorting by metadata is the one case that has to stat every row; it goes out as one batch.
+    bool metadataSort = sortColumn == 1 || sortColumn == 3;
+    if (metadataSort && requireFields(sortColumn == 1 ? SizeField : ModifiedField))
+        sorted = 0;
+    std::vector<quint32> unstatted;
+    for (size_t row = sorted; row < rows.size(); ++row) {
+        quint32 entry = rows[row];
+        bool typeUnknown = types[entry] == UnknownType || types[entry] == SymlinkType;
+        if (statStates[entry] == NotStatted && (metadataSort || typeUnknown))
+            unstatted.push_back(entry);
+    }
+    statEntries(unstatted);
+    updateNameRanks();
+    if (sortColumn == 2)
+        updateSuffixRanks();
+
+    // Folders stay first in both orders; descending flips the column value and the name rank.
+    struct SortKey {
+        quint64 value;
+        quint32 rank;
+        quint32 entry;
+        bool file;
+    };
+
+    bool descending = sortOrder == Qt::DescendingOrder;
+    auto keyOf = [&](quint32 entry) {
+        quint64 value = 0;
+        switch (sortColumn) {
+            case 1: value = quint64(folderSizeOf(entry)) ^ (quint64(1) << 63); break;
+            case 2: value = suffixRanks[suffixIds[entry]]; break;
+            case 3: value = quint64(modified[entry]) ^ (quint64(1) << 63); break;
+            default: break;
+        }
+        quint32 rank = nameRanks[entry];
+        if (descending) {
+            value = ~value;
+            rank = ~rank;
+        }
+        return SortKey{value, rank, entry, !entryIsDir(entry)};
+    };
+
+    std::vector<SortKey> keys(rows.size());
+    for (size_t row = 0; row < rows.size(); ++row)
+        keys[row] = keyOf(rows[row]);
+
+    auto less = [](const SortKey& a, const SortKey& b) {
+        if (a.file != b.file)
+            return b.file;
+        if (a.value != b.value)
+            return a.value < b.value;
+        return a.rank < b.rank;
+    };
+
+    // Rows appended since the last sort are sorted on their own and merged in, so a few new rows cost O(n).
+    parallelSort(keys.begin() + qptrdiff(sorted), keys.end(), less);
+    std::inplace_merge(keys.begin(), keys.begin() + qptrdiff(sorted), keys.end(), less);
+
+    for (size_t row = 0; row < rows.size(); ++row)
+        rows[row] = keys[row].entry;
+    sortedRowCount = rows.size();
+}
+
+void DirectoryModel::updateNameRanks() {
+    size_t count = types.size();
+    if (nameRanks.size() == count)
+        return;
+
+    size_t known = nameOrder.size();
+    if (known < count) {
+        nameOrder.resize(count);
+        std::iota(nameOrder.begin() + qptrdiff(known), nameOrder.end(), quint32(known));
+        auto less = [this](quint32 a, quint32 b) { return keyLess(a, b); };
+        parallelSort(nameOrder.begin() + qptrdiff(known), nameOrder.end(), less);
+        std::inplace_merge(nameOrder.begin(), nameOrder.begin() + qptrdiff(known), nameOrder.end(), less);
+    }
+
+    nameRanks.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        nameRanks[nameOrder[i]] = quint32(i);
+}
+
+void DirectoryModel::updateSuffixRanks() {
+    if (suffixRanks.size() == size_t(suffixTypes.size()))
+        return;
+
+    std::vector<quint32> order(size_t(suffixTypes.size()));
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](quint32 a, quint32 b) {
+        int result = QString::compare(suffixTypes[a], suffixTypes[b]);
+        return result != 0 ? result < 0 : a < b;
+    });
+
+    suffixRanks.resize(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        suffixRanks[order[i]] = quint32(i);
+}
+
+bool DirectoryModel::keyLess(quint32 a, quint32 b) const {
+    int result = std::strcmp(keyAt(a), keyAt(b));
+    if (result == 0)
+        result = compareNames(nameAt(a), nameLength(a), nameAt(b), nameLength(b));
+    return result != 0 ? result < 0 : a < b;
+}
+
+QString DirectoryModel::filePath(const QModelIndex& index) const {
+    if (!index.isValid())
+        return root;
+    return root + QLatin1Char('/') + nameString(entryAt(index));
+}
+
+QString DirectoryModel::fileName(const QModelIndex& index) const {
+    return index.isValid() ? nameString(entryAt(index)) : QString();
+}
+
+bool DirectoryModel::isDir(const QModelIndex& index) const {
+    return index.isValid() && entryIsDir(entryAt(index));
+}
+
+QDateTime DirectoryModel::lastModified(const QModelIndex& index) const {
+    if (!index.isValid() || size_t(index.row()) >= rows.size() || !(statFields & ModifiedField))
+        return QDateTime();
+    quint32 entry = entryAt(index);
+    ensureStat(entry);
+    return statStates[entry] == Statted ? QDateTime::fromMSecsSinceEpoch(modified[entry]) : QDateTime();
+}
+
+int DirectoryModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : int(rows.size());
+}
+
+int DirectoryModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : 4;
+}
+
+QVariant DirectoryModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || size_t(index.row()) >= rows.size())
+        return QVariant();
+
+    quint32 entry = entryAt(index);
+
+    if (statStates[entry] == NotStatted) {
+        bool shown = role == Qt::DisplayRole || role == Qt::EditRole || role == Qt::DecorationRole;
+        bool metadataCell = index.column() == 1 || index.column() == 3;
+        if (shown && (metadataCell || types[entry] == UnknownType || types[entry] == SymlinkType))
+            statRows(size_t(index.row()));
+    }
+
+    switch (role) {
+        case QFileSystemModel::FilePathRole:
+            return filePath(index);
+        case QFileSystemModel::FileNameRole:
+            return nameString(entry);
+        case Qt::DecorationRole:
+            if (index.column() == 0) {
+                IconCache& icons = IconCache::shared();
+                if (entryIsDir(entry))
+                    return icons.folderIcon();
+                QIcon icon = icons.iconForName(nameString(entry));
+                if (icon.isNull())
+                    icon = slowMount ? icons.fileIcon() : icons.iconForFile(filePath(index));
+                return icon;
+            }
+            return QVariant();
+        case Qt::TextAlignmentRole:
+            if (index.column() == 1)
+                return int(Qt::AlignRight | Qt::AlignVCenter);
+            return QVariant();
+        case Qt::ToolTipRole:
+            if ((index.column() == 1 || index.column() == 3) && statStates[entry] == StatTimedOut)
+                return QStringLiteral("The file system is not responding");
+            if (index.column() == 1 && entry < folderPartial.size() && folderPartial[entry])
+                return QStringLiteral("Some subfolders could not be read; the size counts only the rest");
+            return QVariant();
+        case Qt::EditRole:
+            if (index.column() == 1) {
+                ensureStat(entry);
+                return folderSizeOf(entry);
+            }
+            if (index.column() == 3) {
+                ensureStat(entry);
+                return statStates[entry] == Statted ? QDateTime::fromMSecsSinceEpoch(modified[entry]) : QVariant();
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (role != Qt::DisplayRole && role != Qt::EditRole)
+        return QVariant();
+
+    switch (index.column()) {
+        case 0:
+            return nameString(entry);
+        case 1:
+            if (entryIsDir(entry)) {
+                if (entry >= folderBytes.size() || folderBytes[entry] < 0)
+                    return QString();
+                QString size = QLocale::system().formattedDataSize(folderBytes[entry]);
+                if (folderPartial[entry])
+                    size.prepend(QChar(0x2265));
+                return folderComplete[entry] ? size : size + QChar(0x2026);
+            }
+            ensureStat(entry);
+            if (awaitingStat(entry))
+                return QString(QChar(0x2026));
+            return statStates[entry] == Statted ? QLocale::system().formattedDataSize(sizes[entry]) : QString();
+        case 2:
+            return entryIsDir(entry) ? QStringLiteral("File folder") : suffixTypes[suffixIds[entry]];
+        case 3:
+            ensureStat(entry);
+            if (awaitingStat(entry))
+                return QString(QChar(0x2026));
+            if (statStates[entry] != Statted)
+                return QString();
+            return QLocale::system().toString(QDateTime::fromMSecsSinceEpoch(modified[entry]), QLocale::ShortFormat);
+    }
+
+    return QVariant();
+}
+
+QVariant DirectoryModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QAbstractTableModel::headerData(section, orientation, role);
+
+    switch (section) {
+        case 0: return QStringLiteral("Name");
+        case 1: return QStringLiteral("Size");
+        case 2: return QStringLiteral("Type");
+        case 3: return QStringLiteral("Date Modified");
+    }
+    return QVariant();
+}
@@ -0,0 +1,218 @@
+#ifndef DIRECTORYMODEL_H
+#define DIRECTORYMODEL_H
+
+#include <QAbstractTableModel>
+#include <QByteArray>
+#include <QCache>
+#include <QDateTime>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include <vector>
+
+class FolderSizeScanner;
+class MetadataLoader;
+class QThreadPool;
+class QTimer;
+struct FolderSize;
+struct MetadataResult;
+struct ListingJob;
+struct ListingBatch;
+struct PrefetchJob;
+struct PrefetchedListing;
+
+class DirectoryModel : public QAbstractTableModel {
+    Q_OBJECT
+public:
+    enum EntryType : quint8 {
+        UnknownType,
+        FileType,
+        DirectoryType,
+        SymlinkType,
+        OtherType
+    };
+
+    enum MetadataField {
+        SizeField = 0x1,
+        ModifiedField = 0x2
+    };
+
+    explicit DirectoryModel(QObject* parent = nullptr);
+    ~DirectoryModel();
+
+    void setRootPath(const QString& path);
+    QString rootPath() const { return root; }
+
+    bool isLoading() const { return job != nullptr; }
+
+    struct CacheStats {
+        qint64 hits;
+        qint64 staleHits;
+        qint64 misses;
+        qint64 prefetched;
+        qint64 bytes;
+        qsizetype listings;
+    };
+
+    CacheStats cacheStats() const;
+
+    void setCacheBudget(qint64 bytes);
+
+    void prefetch(const QStringList& paths);
+
+    void cancelPrefetch();
+
+    // Fields the current view shows; entries are stat'ed for these only, plus whatever a sort needs.
+    void setMetadataFields(int fields);
+
+    // Shows the recursive disk usage of subfolders in the Size column, streamed in while it is computed.
+    void setFolderSizesEnabled(bool enabled);
+    bool folderSizesEnabled() const { return showFolderSizes; }
+
+    QString filePath(const QModelIndex& index) const;
+    QString fileName(const QModelIndex& index) const;
+    bool isDir(const QModelIndex& index) const;
+    // Invalid until the entry has been stat'ed with ModifiedField; asking queues the stat.
+    QDateTime lastModified(const QModelIndex& index) const;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+signals:
+    void directoryLoaded(const QString& path);
+
+private:
+    enum StatState : quint8 {
+        NotStatted,
+        Statted,
+        StatFailed,
+        StatPending,
+        StatTimedOut
+    };
+
+    struct ListingSnapshot {
+        quint64 device;
+        quint64 inode;
+        qint64 mtimeNsecs;
+        QByteArray nameArena;
+        std::vector<quint32> nameOffsets;
+        QByteArray keyArena;
+        std::vector<quint32> keyOffsets;
+        std::vector<quint32> nameOrder;
+        std::vector<quint8> types;
+        std::vector<quint16> suffixIds;
+        std::vector<qint64> sizes;
+        std::vector<qint64> modified;
+
+        qint64 cost() const;
+    };
+
+    QString root;
+    int rootFd;
+    quint64 rootDevice;
+    quint64 rootInode;
+    qint64 rootMtimeNsecs;
+    // Set for network and FUSE mounts: the folder is never opened or stat'ed on the GUI thread, entry
+    // metadata comes from the loader and rows show placeholders until it arrives.
+    bool slowMount;
+
+    // One slot per directory entry, indexed by entry id; rows maps view order onto ids.
+    QByteArray nameArena;
+    std::vector<quint32> nameOffsets;
+    mutable std::vector<quint8> types;
+    std::vector<quint16> suffixIds;
+    mutable std::vector<quint8> statStates;
+    mutable std::vector<qint64> sizes;
+    mutable std::vector<qint64> modified;
+    std::vector<quint32> rows;
+    size_t sortedRowCount;
+
+    // Natural-order sort keys, NUL-terminated like the names; nameOrder lists entries by key and
+    // nameRanks inverts it so every sort compares integers instead of strings.
+    QByteArray keyArena;
+    std::vector<quint32> keyOffsets;
+    std::vector<quint32> nameOrder;
+    std::vector<quint32> nameRanks;
+    std::vector<quint32> suffixRanks;
+
+    QHash<QByteArray, quint16> suffixLookup;
+    QVector<QString> suffixTypes;
+
+    int sortColumn;
+    Qt::SortOrder sortOrder;
+
+
+    QThreadPool* pool;
+    QTimer* drainTimer;
+    std::shared_ptr<ListingJob> job;
+    QThreadPool* prefetchPool;
+    std::shared_ptr<PrefetchJob> prefetchJob;
+
+    MetadataLoader* metadata;
+    mutable int pendingStats;
+    int viewFields;
+    mutable int statFields;
+
+    FolderSizeScanner* folderSizes;
+    bool showFolderSizes;
+    // folderBytes, folderComplete and folderPartial are indexed by entry id and stay empty until a scan
+    // starts; scannedFolders maps the scanner's folder numbers back to entries.
+    std::vector<quint32> scannedFolders;
+    std::vector<qint64> folderBytes;
+    std::vector<quint8> folderComplete;
+    std::vector<quint8> folderPartial;
+
+    QCache<QString, ListingSnapshot> cache;
+    qint64 cacheHits;
+    qint64 cacheStaleHits;
+    qint64 cacheMisses;
+    qint64 prefetchedListings;
+
+    void clearEntries();
+    void resetEntries();
+    void storeSnapshot();
+    bool restoreSnapshot(bool* stale);
+    void storePrefetched(const PrefetchedListing& listing);
+    void startListing(bool replace);
+    void cancelListing();
+    void drainListing();
+    void finishListing();
+    void applyMetadata(const QVector<MetadataResult>& results);
+    void startFolderSizes();
+    void applyFolderSizes(const QVector<FolderSize>& updates);
+    void folderSizesFinished();
+    qint64 folderSizeOf(quint32 entry) const;
+    void appendBatch(const ListingBatch& batch);
+    void appendEntry(const char* name, qsizetype length, const char* key, qsizetype keyLength, quint8 type);
+    void applySort();
+    quint16 internSuffix(const char* name, qsizetype length);
+    void rebuildRows();
+    void sortRows();
+    void updateNameRanks();
+    void updateSuffixRanks();
+    bool keyLess(quint32 a, quint32 b) const;
+
+    const char* nameAt(quint32 entry) const { return nameArena.constData() + nameOffsets[entry]; }
+    qsizetype nameLength(quint32 entry) const { return qsizetype(nameOffsets[entry + 1] - nameOffsets[entry]) - 1; }
+    QString nameString(quint32 entry) const { return QString::fromUtf8(nameAt(entry), nameLength(entry)); }
+    const char* keyAt(quint32 entry) const { return keyArena.constData() + keyOffsets[entry]; }
+
+    bool rootAvailable() const { return rootFd >= 0 || slowMount; }
+    void ensureStat(quint32 entry) const;
+    void statRows(size_t firstRow) const;
+    void statEntries(const std::vector<quint32>& entries) const;
+    bool requireFields(int fields) const;
+    unsigned int statMask() const;
+    void applyStat(quint32 entry, quint32 mode, qint64 size, qint64 modifiedMsecs) const;
+    // Metadata still in flight on a slow mount; its cells show a placeholder.
+    bool awaitingStat(quint32 entry) const { return statStates[entry] == StatPending || statStates[entry] == StatTimedOut; }
+    bool entryIsDir(quint32 entry) const;
+    quint32 entryAt(const QModelIndex& index) const { return rows[size_t(index.row())]; }
+};
+
+#endif
@@ -0,0 +1,299 @@
+#include "duplicatefinder.h"
+#include "xxhash64.h"
+#include <QDirIterator>
+#include <QFile>
+#include <QPair>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace {
+
+const qint64 EDGE_SIZE = 64 * 1024;
+const qint64 READ_CHUNK_SIZE = 1024 * 1024;
+const size_t HASH_BATCH_SIZE = 32;
+
+struct FileEntry {
+    QString path;
+    qint64 size;
+    qint64 modifiedMsecs;
+    quint64 partial;
+    quint64 full;
+    bool complete;
+    bool readable;
+};
+
+// Files up to two edges long are read whole here, so they never need a second pass.
+void hashEdges(FileEntry& entry) {
+    QFile file(entry.path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        entry.readable = false;
+        return;
+    }
+
+    if (entry.size <= 2 * EDGE_SIZE) {
+        QByteArray contents = file.readAll();
+        entry.readable = contents.size() == entry.size;
+        entry.partial = entry.full = XxHash64::hash(contents.constData(), contents.size(), quint64(entry.size));
+        entry.complete = true;
+        return;
+    }
+
+    QByteArray edges(2 * EDGE_SIZE, Qt::Uninitialized);
+    entry.readable = file.read(edges.data(), EDGE_SIZE) == EDGE_SIZE &&
+                     file.seek(entry.size - EDGE_SIZE) &&
+                     file.read(edges.data() + EDGE_SIZE, EDGE_SIZE) == EDGE_SIZE;
+    entry.partial = XxHash64::hash(edges.constData(), edges.size(), quint64(entry.size));
+}
+
+void hashContents(FileEntry& entry, const std::atomic<bool>& cancelled) {
+    QFile file(entry.path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        entry.readable = false;
+        return;
+    }
+    ::posix_fadvise(file.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    XxHash64 state(quint64(entry.size));
+    QByteArray buffer(READ_CHUNK_SIZE, Qt::Uninitialized);
+    qint64 total = 0;
+    qint64 got;
+    while ((got = file.read(buffer.data(), buffer.size())) > 0) {
+        if (cancelled.load(std::memory_order_relaxed))
+            return;
+        state.update(buffer.constData(), got);
+        total += got;
+    }
+
+    entry.readable = total == entry.size;
+    entry.full = state.digest();
+    entry.complete = true;
+}
+
+// A 64-bit hash only makes a match likely; deleting a file on the strength of one needs the bytes.
+bool sameContents(const FileEntry& a, const FileEntry& b, const std::atomic<bool>& cancelled) {
+    QFile first(a.path);
+    QFile second(b.path);
+    if (!first.open(QIODevice::ReadOnly) || !second.open(QIODevice::ReadOnly))
+        return false;
+    ::posix_fadvise(first.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    ::posix_fadvise(second.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    QByteArray left(READ_CHUNK_SIZE, Qt::Uninitialized);
+    QByteArray right(READ_CHUNK_SIZE, Qt::Uninitialized);
+    qint64 total = 0;
+    while (total < a.size) {
+        if (cancelled.load(std::memory_order_relaxed))
+            return false;
+        qint64 want = std::min(READ_CHUNK_SIZE, a.size - total);
+        if (first.read(left.data(), want) != want || second.read(right.data(), want) != want ||
+            std::memcmp(left.constData(), right.constData(), size_t(want)) != 0)
+            return false;
+        total += want;
+    }
+    // Either file may have grown since it was hashed.
+    return first.atEnd() && second.atEnd();
+}
+
+}
+
+struct DuplicateJob {
+    QString root;
+    QThreadPool* hashPool;
+    std::atomic<bool> cancelled{false};
+    std::vector<FileEntry> files;
+
+    void forEach(const std::vector<size_t>& ids, const std::function<void(FileEntry&)>& work) {
+        for (size_t first = 0; first < ids.size(); first += HASH_BATCH_SIZE) {
+            size_t last = std::min(ids.size(), first + HASH_BATCH_SIZE);
+            hashPool->start([this, &ids, &work, first, last]() {
+                for (size_t i = first; i < last && !cancelled.load(std::memory_order_relaxed); ++i)
+                    work(files[ids[i]]);
+            });
+        }
+        hashPool->waitForDone();
+    }
+
+    void collect() {
+        QSet<QPair<quint64, quint64>> seenInodes;
+        QDirIterator it(root, QDir::Files | QDir::Hidden | QDir::System | QDir::NoSymLinks,
+                        QDirIterator::Subdirectories);
+        while (it.hasNext() && !cancelled.load(std::memory_order_relaxed)) {
+            QString path = it.next();
+            struct stat st;
+            if (::lstat(QFile::encodeName(path).constData(), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+                continue;
+
+            // Hard links share storage, so only one name per inode can be reclaimed.
+            if (st.st_nlink > 1) {
+                QPair<quint64, quint64> inode(quint64(st.st_dev), quint64(st.st_ino));
+                if (seenInodes.contains(inode))
+                    continue;
+                seenInodes.insert(inode);
+            }
+
+            qint64 modified = qint64(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+            files.push_back({path, qint64(st.st_size), modified, 0, 0, false, true});
+        }
+    }
+
+    // Splits files with equal hashes into sets whose bytes are equal. Each file is compared with the first
+    // member of each set until one matches, so in the usual case of no collision that is one comparison.
+    std::vector<std::vector<size_t>> verify(const std::vector<size_t>& ids) {
+        std::vector<std::vector<size_t>> sets;
+        for (size_t id : ids) {
+            if (cancelled.load(std::memory_order_relaxed))
+                break;
+            auto set = std::find_if(sets.begin(), sets.end(), [this, id](const std::vector<size_t>& members) {
+                return sameContents(files[members.front()], files[id], cancelled);
+            });
+            if (set != sets.end())
+                set->push_back(id);
+            else
+                sets.push_back({id});
+        }
+        return sets;
+    }
+
+    QVector<DuplicateGroup> run(const std::function<void(const QString&)>& report) {
+        report(QStringLiteral("Finding duplicates: scanning %1").arg(root));
+        collect();
+
+        std::unordered_map<qint64, std::vector<size_t>> bySize;
+        for (size_t id = 0; id < files.size(); ++id)
+            bySize[files[id].size].push_back(id);
+
+        std::vector<size_t> sameSize;
+        for (const auto& bucket : bySize) {
+            if (bucket.second.size() > 1)
+                sameSize.insert(sameSize.end(), bucket.second.begin(), bucket.second.end());
+        }
+        if (cancelled.load())
+            return {};
+
+        report(QStringLiteral("Finding duplicates: comparing %1 of %2 files")
+                   .arg(sameSize.size()).arg(files.size()));
+        forEach(sameSize, [](FileEntry& entry) { hashEdges(entry); });
+
+        std::map<std::pair<qint64, quint64>, std::vector<size_t>> byEdges;
+        for (size_t id : sameSize) {
+            if (files[id].readable)
+                byEdges[{files[id].size, files[id].partial}].push_back(id);
+        }
+
+        std::vector<size_t> needFull;
+        std::vector<size_t> survivors;
+        for (const auto& bucket : byEdges) {
+            if (bucket.second.size() < 2)
+                continue;
+            for (size_t id : bucket.second) {
+                survivors.push_back(id);
+                if (!files[id].complete)
+                    needFull.push_back(id);
+            }
+        }
+        if (cancelled.load())
+            return {};
+
+        report(QStringLiteral("Finding duplicates: hashing %1 files").arg(needFull.size()));
+        forEach(needFull, [this](FileEntry& entry) { hashContents(entry, cancelled); });
+        if (cancelled.load())
+            return {};
+
+        std::map<std::pair<qint64, quint64>, std::vector<size_t>> byContents;
+        for (size_t id : survivors) {
+            if (files[id].readable && files[id].complete)
+                byContents[{files[id].size, files[id].full}].push_back(id);
+        }
+
+        std::vector<std::pair<quint64, std::vector<size_t>>> candidates;
+        size_t candidateFiles = 0;
+        for (const auto& bucket : byContents) {
+            if (bucket.second.size() < 2)
+                continue;
+            candidates.emplace_back(bucket.first.second, bucket.second);
+            candidateFiles += bucket.second.size();
+        }
+
+        report(QStringLiteral("Finding duplicates: verifying %1 files").arg(candidateFiles));
+        std::vector<std::vector<std::vector<size_t>>> verified(candidates.size());
+        for (size_t c = 0; c < candidates.size(); ++c)
+            hashPool->start([this, &candidates, &verified, c]() { verified[c] = verify(candidates[c].second); });
+        hashPool->waitForDone();
+        if (cancelled.load())
+            return {};
+
+        QVector<DuplicateGroup> groups;
+        for (size_t c = 0; c < candidates.size(); ++c) {
+            for (const std::vector<size_t>& ids : verified[c]) {
+                if (ids.size() < 2)
+                    continue;
+                DuplicateGroup group{files[ids.front()].size, candidates[c].first, {}};
+                for (size_t id : ids) {
+                    const FileEntry& entry = files[id];
+                    group.files.append(SearchHit{entry.path, entry.path.section(QLatin1Char('/'), -1), entry.size,
+                                                 QDateTime::fromMSecsSinceEpoch(entry.modifiedMsecs), false});
+                }
+                groups.append(group);
+            }
+        }
+
+        std::sort(groups.begin(), groups.end(), [](const DuplicateGroup& a, const DuplicateGroup& b) {
+            return a.reclaimable() > b.reclaimable();
+        });
+        return groups;
+    }
+};
+
+DuplicateFinder::DuplicateFinder(QObject* parent)
+    : QObject(parent), coordinator(new QThreadPool(this)), hashPool(new QThreadPool(this)) {
+    coordinator->setMaxThreadCount(1);
+    hashPool->setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+}
+
+DuplicateFinder::~DuplicateFinder() {
+    cancel();
+    coordinator->waitForDone();
+    hashPool->waitForDone();
+}
+
+void DuplicateFinder::start(const QString& rootPath) {
+    cancel();
+
+    job = std::make_shared<DuplicateJob>();
+    job->root = rootPath;
+    job->hashPool = hashPool;
+
+    std::shared_ptr<DuplicateJob> current = job;
+    coordinator->start([this, current]() {
+        QVector<DuplicateGroup> groups = current->run([this, current](const QString& message) {
+            QMetaObject::invokeMethod(this, [this, current, message]() {
+                if (job == current)
+                    emit progress(message);
+            }, Qt::QueuedConnection);
+        });
+
+        QMetaObject::invokeMethod(this, [this, current, groups]() {
+            if (job != current)
+                return;
+            job.reset();
+            emit finished(groups);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DuplicateFinder::cancel() {
+    if (!job)
+        return;
+
+    job->cancelled = true;
+    job.reset();
+}
@@ -0,0 +1,47 @@
+#ifndef DUPLICATEFINDER_H
+#define DUPLICATEFINDER_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <memory>
+
+#include "searchengine.h"
+
+class QThreadPool;
+
+struct DuplicateGroup {
+    qint64 size;
+    quint64 digest;
+    QVector<SearchHit> files;
+
+    qint64 reclaimable() const { return size * (files.size() - 1); }
+};
+
+struct DuplicateJob;
+
+class DuplicateFinder : public QObject {
+    Q_OBJECT
+public:
+    explicit DuplicateFinder(QObject* parent = nullptr);
+    ~DuplicateFinder();
+
+    void start(const QString& rootPath);
+
+    void cancel();
+
+    bool isRunning() const { return job != nullptr; }
+
+signals:
+    void progress(const QString& message);
+
+    void finished(const QVector<DuplicateGroup>& groups);
+
+private:
+    QThreadPool* coordinator;
+    QThreadPool* hashPool;
+    std::shared_ptr<DuplicateJob> job;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "duplicatesmodel.h"
+#include "iconcache.h"
+#include <QFileSystemModel>
+#include <QLocale>
+
+DuplicatesModel::DuplicatesModel(QObject* parent)
+    : QAbstractTableModel(parent), reclaimable(0) {
+    connect(&IconCache::shared(), &IconCache::fileIconsChanged, this, [this]() {
+        if (!rows.isEmpty())
+            emit dataChanged(index(0, 0), index(rows.size() - 1, 0), {Qt::DecorationRole});
+    });
+}
+
+int DuplicatesModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : rows.size();
+}
+
+int DuplicatesModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : 4;
+}
+
+QVariant DuplicatesModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= rows.size())
+        return QVariant();
+
+    const QPair<int, int>& row = rows.at(index.row());
+    const DuplicateGroup& group = groups.at(row.first);
+    const SearchHit& entry = group.files.at(row.second);
+
+    switch (role) {
+        case QFileSystemModel::FilePathRole:
+        case Qt::ToolTipRole:
+            return entry.path;
+        case QFileSystemModel::FileNameRole:
+            return entry.name;
+        case Qt::DecorationRole:
+            if (index.column() == 0) {
+                IconCache& icons = IconCache::shared();
+                QIcon icon = icons.iconForName(entry.name);
+                if (icon.isNull())
+                    icon = mounts.mountFor(entry.path).slow ? icons.fileIcon() : icons.iconForFile(entry.path);
+                return icon;
+            }
+            return QVariant();
+        case Qt::EditRole:
+            if (index.column() == 1)
+                return entry.size;
+            if (index.column() == 2)
+                return row.first;
+            if (index.column() == 3)
+                return entry.lastModified;
+            break;
+        case Qt::TextAlignmentRole:
+            if (index.column() == 1)
+                return int(Qt::AlignRight | Qt::AlignVCenter);
+            return QVariant();
+        default:
+            break;
+    }
+
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (index.column()) {
+        case 0:
+            return entry.name;
+        case 1:
+            return QLocale::system().formattedDataSize(entry.size);
+        case 2:
+            return QStringLiteral("Set %1 (%2 copies)").arg(row.first + 1).arg(group.files.size());
+        case 3:
+            return QLocale::system().toString(entry.lastModified, QLocale::ShortFormat);
+    }
+
+    return QVariant();
+}
+
+QVariant DuplicatesModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QAbstractTableModel::headerData(section, orientation, role);
+
+    switch (section) {
+        case 0: return QStringLiteral("Name");
+        case 1: return QStringLiteral("Size");
+        case 2: return QStringLiteral("Duplicate Set");
+        case 3: return QStringLiteral("Date Modified");
+    }
+    return QVariant();
+}
+
+void DuplicatesModel::setGroups(const QVector<DuplicateGroup>& newGroups) {
+    beginResetModel();
+    groups = newGroups;
+    mounts = MountTable::read();
+    rows.clear();
+    reclaimable = 0;
+    for (int g = 0; g < groups.size(); ++g) {
+        reclaimable += groups[g].reclaimable();
+        for (int f = 0; f < groups[g].files.size(); ++f)
+            rows.append(qMakePair(g, f));
+    }
+    endResetModel();
+}
+
+void DuplicatesModel::clear() {
+    setGroups(QVector<DuplicateGroup>());
+}
@@ -0,0 +1,37 @@
+#ifndef DUPLICATESMODEL_H
+#define DUPLICATESMODEL_H
+
+#include <QAbstractTableModel>
+#include <QPair>
+#include <QVector>
+
+#include "duplicatefinder.h"
+#include "mounttable.h"
+
+class DuplicatesModel : public QAbstractTableModel {
+    Q_OBJECT
+public:
+    explicit DuplicatesModel(QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void setGroups(const QVector<DuplicateGroup>& newGroups);
+
+    void clear();
+
+    int groupCount() const { return groups.size(); }
+
+    qint64 reclaimableBytes() const { return reclaimable; }
+
+private:
+    // Read when the results are replaced, so painting never rereads the mount table.
+    MountTable mounts;
+    QVector<DuplicateGroup> groups;
+    QVector<QPair<int, int>> rows;
+    qint64 reclaimable;
+};
+
+#endif
@@ -0,0 +1,541 @@
+#include "filenameindex.h"
+#include "fuzzymatcher.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+Q_LOGGING_CATEGORY(lcIndex, "explosion.index", QtInfoMsg)
+
+namespace {
+
+const char INDEX_MAGIC[8] = {'E', 'X', 'P', 'L', 'I', 'D', 'X', '1'};
+const quint32 INDEX_VERSION = 2;
+
+struct IndexHeader {
+    char magic[8];
+    quint32 version;
+    quint32 trigramCount;
+    quint64 pathCount;
+    qint64 builtAtMsecs;
+    qint64 buildTimeMsecs;
+    quint64 rootsOffset;
+    quint64 rootsSize;
+    quint64 pathOffsetsOffset;
+    quint64 pathBlobOffset;
+    quint64 nameOffsetsOffset;
+    quint64 nameBlobOffset;
+    quint64 trigramTableOffset;
+    quint64 postingsOffset;
+    // Every folder walked, roots included, with its modification time in msecs when it was listed.
+    quint64 directoryCount;
+    quint64 directoryOffsetsOffset;
+    quint64 directoryBlobOffset;
+    quint64 directoryMtimesOffset;
+};
+
+struct TrigramEntry {
+    quint32 trigram;
+    quint32 count;
+    quint64 first;
+};
+
+quint32 trigramAt(const char* p) {
+    return (quint32(uchar(p[0])) << 16) | (quint32(uchar(p[1])) << 8) | quint32(uchar(p[2]));
+}
+
+// Whether count elements of elementSize bytes starting at offset lie inside a file of size bytes, aligned
+// for the element type; written so that none of the arithmetic can overflow.
+bool sectionFits(quint64 offset, quint64 count, quint64 elementSize, quint64 alignment, quint64 size) {
+    return offset % alignment == 0 && offset <= size && count <= (size - offset) / elementSize;
+}
+
+// An offset table of count + 1 entries must start at 0, never decrease and end inside its blob.
+bool offsetsValid(const uchar* data, quint64 tableOffset, quint64 count, quint64 blobOffset, quint64 size) {
+    const quint64* offsets = reinterpret_cast<const quint64*>(data + tableOffset);
+    if (offsets[0] != 0 || blobOffset > size || offsets[count] > size - blobOffset)
+        return false;
+    for (quint64 i = 0; i < count; ++i) {
+        if (offsets[i] > offsets[i + 1])
+            return false;
+    }
+    return true;
+}
+
+// Checks every section of a mapped index, so that queries can index into it without further checks
+// beyond posting ids, which are compared against the path count where they are used.
+bool indexValid(const uchar* data, quint64 size) {
+    const IndexHeader* header = reinterpret_cast<const IndexHeader*>(data);
+    if (std::memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header->version != INDEX_VERSION)
+        return false;
+    // pathCount + 1 offsets are stored per table.
+    if (header->pathCount >= size / sizeof(quint64))
+        return false;
+
+    if (header->directoryCount >= size / sizeof(quint64))
+        return false;
+
+    quint64 offsetCount = header->pathCount + 1;
+    if (!sectionFits(header->rootsOffset, header->rootsSize, 1, 1, size) ||
+        !sectionFits(header->pathOffsetsOffset, offsetCount, sizeof(quint64), alignof(quint64), size) ||
+        !sectionFits(header->nameOffsetsOffset, offsetCount, sizeof(quint64), alignof(quint64), size) ||
+        !sectionFits(header->trigramTableOffset, header->trigramCount, sizeof(TrigramEntry), alignof(TrigramEntry),
+                     size) ||
+        !sectionFits(header->postingsOffset, 0, sizeof(quint32), alignof(quint32), size) ||
+        !sectionFits(header->directoryOffsetsOffset, header->directoryCount + 1, sizeof(quint64), alignof(quint64),
+                     size) ||
+        !sectionFits(header->directoryMtimesOffset, header->directoryCount, sizeof(qint64), alignof(qint64), size))
+        return false;
+
+    if (!offsetsValid(data, header->pathOffsetsOffset, header->pathCount, header->pathBlobOffset, size) ||
+        !offsetsValid(data, header->nameOffsetsOffset, header->pathCount, header->nameBlobOffset, size) ||
+        !offsetsValid(data, header->directoryOffsetsOffset, header->directoryCount, header->directoryBlobOffset, size))
+        return false;
+
+    quint64 postingCount = (size - header->postingsOffset) / sizeof(quint32);
+    const TrigramEntry* table = reinterpret_cast<const TrigramEntry*>(data + header->trigramTableOffset);
+    for (quint32 i = 0; i < header->trigramCount; ++i) {
+        if (table[i].first > postingCount || table[i].count > postingCount - table[i].first)
+            return false;
+        // Lookups binary-search the table.
+        if (i > 0 && table[i - 1].trigram >= table[i].trigram)
+            return false;
+    }
+    return true;
+}
+
+QByteArray foldName(const QString& name) {
+    return name.toLower().toUtf8();
+}
+
+class IndexWriter {
+public:
+    explicit IndexWriter(QSaveFile& out) : out(out), offset(0) {}
+
+    quint64 write(const void* data, qint64 size) {
+        static const char padding[8] = {};
+        qint64 pad = (8 - offset % 8) % 8;
+        if (pad)
+            out.write(padding, pad);
+        offset += pad;
+        quint64 start = offset;
+        out.write(static_cast<const char*>(data), size);
+        offset += size;
+        return start;
+    }
+
+    template <typename T>
+    quint64 write(const std::vector<T>& values) {
+        return write(values.data(), qint64(values.size() * sizeof(T)));
+    }
+
+private:
+    QSaveFile& out;
+    qint64 offset;
+};
+
+bool buildIndexFile(const QStringList& roots, const QString& target,
+                    const std::atomic<bool>& cancelled, qint64* buildTimeMsecs) {
+    QElapsedTimer timer;
+    timer.start();
+    QDateTime builtAt = QDateTime::currentDateTimeUtc();
+
+    QByteArray pathBlob;
+    QByteArray nameBlob;
+    std::vector<quint64> pathOffsets{0};
+    std::vector<quint64> nameOffsets{0};
+    std::unordered_map<quint32, std::vector<quint32>> postings;
+    std::vector<quint32> nameTrigrams;
+    QByteArray directoryBlob;
+    std::vector<quint64> directoryOffsets{0};
+    std::vector<qint64> directoryMtimes;
+
+    // Stat'ed before the folder is listed, so a change made in between leaves the recorded time behind.
+    auto addDirectory = [&](const QString& path, const QFileInfo& info) {
+        directoryBlob += path.toUtf8();
+        directoryOffsets.push_back(quint64(directoryBlob.size()));
+        directoryMtimes.push_back(info.lastModified().toMSecsSinceEpoch());
+    };
+
+    for (const QString& root : roots) {
+        addDirectory(root, QFileInfo(root));
+        QDirIterator it(root, QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            if (cancelled.load(std::memory_order_relaxed))
+                return false;
+
+            QString path = it.next();
+            QFileInfo info = it.fileInfo();
+            if (info.isDir() && !info.isSymLink())
+                addDirectory(path, info);
+            QByteArray folded = foldName(it.fileName());
+            quint32 id = quint32(pathOffsets.size() - 1);
+
+            pathBlob += path.toUtf8();
+            pathOffsets.push_back(quint64(pathBlob.size()));
+            nameBlob += folded;
+            nameOffsets.push_back(quint64(nameBlob.size()));
+
+            nameTrigrams.clear();
+            for (qsizetype i = 0; i + 3 <= folded.size(); ++i)
+                nameTrigrams.push_back(trigramAt(folded.constData() + i));
+            std::sort(nameTrigrams.begin(), nameTrigrams.end());
+            nameTrigrams.erase(std::unique(nameTrigrams.begin(), nameTrigrams.end()), nameTrigrams.end());
+            for (quint32 trigram : nameTrigrams)
+                postings[trigram].push_back(id);
+        }
+    }
+
+    std::vector<quint32> keys;
+    keys.reserve(postings.size());
+    for (const auto& entry : postings)
+        keys.push_back(entry.first);
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<TrigramEntry> table;
+    std::vector<quint32> postingData;
+    table.reserve(keys.size());
+    for (quint32 key : keys) {
+        const std::vector<quint32>& ids = postings[key];
+        table.push_back({key, quint32(ids.size()), quint64(postingData.size())});
+        postingData.insert(postingData.end(), ids.begin(), ids.end());
+    }
+
+    QDir().mkpath(QFileInfo(target).absolutePath());
+    QSaveFile out(target);
+    if (!out.open(QIODevice::WriteOnly))
+        return false;
+
+    IndexHeader header = {};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.trigramCount = quint32(table.size());
+    header.pathCount = quint64(pathOffsets.size() - 1);
+    header.directoryCount = quint64(directoryMtimes.size());
+    header.builtAtMsecs = builtAt.toMSecsSinceEpoch();
+
+    QByteArray rootsBlob = roots.join(QLatin1Char('\n')).toUtf8();
+
+    IndexWriter writer(out);
+    writer.write(&header, sizeof(header));
+    header.rootsOffset = writer.write(rootsBlob.constData(), rootsBlob.size());
+    header.rootsSize = quint64(rootsBlob.size());
+    header.pathOffsetsOffset = writer.write(pathOffsets);
+    header.pathBlobOffset = writer.write(pathBlob.constData(), pathBlob.size());
+    header.nameOffsetsOffset = writer.write(nameOffsets);
+    header.nameBlobOffset = writer.write(nameBlob.constData(), nameBlob.size());
+    header.trigramTableOffset = writer.write(table);
+    header.postingsOffset = writer.write(postingData);
+    header.directoryOffsetsOffset = writer.write(directoryOffsets);
+    header.directoryBlobOffset = writer.write(directoryBlob.constData(), directoryBlob.size());
+    header.directoryMtimesOffset = writer.write(directoryMtimes);
+    header.buildTimeMsecs = timer.elapsed();
+
+    if (cancelled.load() || !out.seek(0))
+        return false;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    *buildTimeMsecs = header.buildTimeMsecs;
+    return out.commit();
+}
+
+}
+
+FilenameIndex::FilenameIndex(QObject* parent)
+    : QObject(parent), pool(new QThreadPool(this)), mapped(nullptr), mappedSize(0),
+      indexFilePath(defaultIndexPath()), maxAgeSecs(24 * 3600), building(false), cancelBuild(false) {
+    pool->setMaxThreadCount(1);
+    indexStats = {0, 0, 0, 0, QDateTime()};
+}
+
+FilenameIndex::~FilenameIndex() {
+    cancelBuild = true;
+    pool->waitForDone();
+    unload();
+}
+
+QString FilenameIndex::defaultIndexPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/explosion/filenames.idx";
+}
+
+void FilenameIndex::setRoots(const QStringList& roots) {
+    indexRoots.clear();
+    for (const QString& root : roots)
+        indexRoots << QDir::cleanPath(QDir(root).absolutePath());
+}
+
+void FilenameIndex::setMaxAge(qint64 seconds) {
+    maxAgeSecs = seconds;
+}
+
+void FilenameIndex::setIndexPath(const QString& path) {
+    unload();
+    indexFilePath = path;
+}
+
+bool FilenameIndex::load() {
+    unload();
+
+    file.setFileName(indexFilePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    mappedSize = file.size();
+    if (mappedSize < qint64(sizeof(IndexHeader))) {
+        unload();
+        return false;
+    }
+
+    mapped = file.map(0, mappedSize);
+    if (!mapped) {
+        unload();
+        return false;
+    }
+
+    const IndexHeader* header = reinterpret_cast<const IndexHeader*>(mapped);
+    if (!indexValid(mapped, quint64(mappedSize))) {
+        qCWarning(lcIndex) << "Ignoring invalid filename index" << indexFilePath;
+        unload();
+        return false;
+    }
+
+    loadedRoots = QString::fromUtf8(reinterpret_cast<const char*>(mapped + header->rootsOffset),
+                                    qsizetype(header->rootsSize)).split(QLatin1Char('\n'), Qt::SkipEmptyParts);
+
+    indexStats.pathCount = qint64(header->pathCount);
+    indexStats.sizeOnDisk = mappedSize;
+    indexStats.buildTimeMsecs = header->buildTimeMsecs;
+    indexStats.builtAt = QDateTime::fromMSecsSinceEpoch(header->builtAtMsecs, Qt::UTC);
+
+    qCInfo(lcIndex) << "Loaded filename index:" << indexStats.pathCount << "paths,"
+                    << indexStats.sizeOnDisk << "bytes, built in" << indexStats.buildTimeMsecs << "ms";
+    return true;
+}
+
+void FilenameIndex::unload() {
+    if (mapped)
+        file.unmap(const_cast<uchar*>(mapped));
+    mapped = nullptr;
+    mappedSize = 0;
+    loadedRoots.clear();
+    if (file.isOpen())
+        file.close();
+}
+
+void FilenameIndex::rebuild() {
+    if (building || indexRoots.isEmpty())
+        return;
+
+    building = true;
+    cancelBuild = false;
+
+    QStringList roots = indexRoots;
+    QString target = indexFilePath;
+    pool->start([this, roots, target]() {
+        qint64 buildTimeMsecs = 0;
+        bool ok = buildIndexFile(roots, target, cancelBuild, &buildTimeMsecs);
+        QMetaObject::invokeMethod(this, [this, ok]() { onBuildFinished(ok); }, Qt::QueuedConnection);
+    });
+}
+
+void FilenameIndex::onBuildFinished(bool ok) {
+    building = false;
+    if (!ok) {
+        qCWarning(lcIndex) << "Filename index build failed or was cancelled";
+        return;
+    }
+
+    if (load())
+        emit rebuilt();
+}
+
+bool FilenameIndex::isStale() const {
+    if (!mapped)
+        return true;
+    if (loadedRoots != indexRoots)
+        return true;
+    return indexStats.builtAt.secsTo(QDateTime::currentDateTimeUtc()) > maxAgeSecs;
+}
+
+bool FilenameIndex::covers(const QString& path) const {
+    if (isStale())
+        return false;
+
+    QString cleanPath = QDir::cleanPath(path);
+    bool underRoot = false;
+    for (const QString& root : loadedRoots) {
+        if (cleanPath == root || cleanPath.startsWith(root.endsWith('/') ? root : root + '/')) {
+            underRoot = true;
+            break;
+        }
+    }
+    return underRoot;
+}
+
+QHash<QString, qint64> FilenameIndex::directories(const QString& basePath, bool recursive) const {
+    QHash<QString, qint64> result;
+    if (!mapped)
+        return result;
+
+    const IndexHeader* header = reinterpret_cast<const IndexHeader*>(mapped);
+    const quint64* offsets = reinterpret_cast<const quint64*>(mapped + header->directoryOffsetsOffset);
+    const char* blob = reinterpret_cast<const char*>(mapped + header->directoryBlobOffset);
+    const qint64* mtimes = reinterpret_cast<const qint64*>(mapped + header->directoryMtimesOffset);
+
+    QByteArray base = QDir::cleanPath(basePath).toUtf8();
+    QByteArray prefix = base.endsWith('/') ? base : base + '/';
+    std::string_view baseView(base.constData(), size_t(base.size()));
+    std::string_view prefixView(prefix.constData(), size_t(prefix.size()));
+
+    for (quint64 id = 0; id < header->directoryCount; ++id) {
+        std::string_view path(blob + offsets[id], size_t(offsets[id + 1] - offsets[id]));
+        bool inside = path == baseView || (recursive && path.substr(0, prefixView.size()) == prefixView);
+        if (inside)
+            result.insert(QString::fromUtf8(path.data(), qsizetype(path.size())), mtimes[id]);
+    }
+    return result;
+}
+
+QStringList FilenameIndex::query(const QString& text, const QString& basePath, bool recursive, bool caseSensitive) {
+    QStringList matches;
+    if (!mapped || text.isEmpty())
+        return matches;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const IndexHeader* header = reinterpret_cast<const IndexHeader*>(mapped);
+    const quint64* pathOffsets = reinterpret_cast<const quint64*>(mapped + header->pathOffsetsOffset);
+    const char* pathBlob = reinterpret_cast<const char*>(mapped + header->pathBlobOffset);
+    const quint64* nameOffsets = reinterpret_cast<const quint64*>(mapped + header->nameOffsetsOffset);
+    const char* nameBlob = reinterpret_cast<const char*>(mapped + header->nameBlobOffset);
+    const TrigramEntry* table = reinterpret_cast<const TrigramEntry*>(mapped + header->trigramTableOffset);
+    const quint32* postings = reinterpret_cast<const quint32*>(mapped + header->postingsOffset);
+
+    QByteArray folded = foldName(text);
+    std::string_view needle(folded.constData(), size_t(folded.size()));
+
+    QByteArray prefix = QDir::cleanPath(basePath).toUtf8();
+    if (!prefix.endsWith('/'))
+        prefix += '/';
+    std::string_view prefixView(prefix.constData(), size_t(prefix.size()));
+
+    auto accept = [&](quint32 id) {
+        if (id >= header->pathCount)
+            return;
+        std::string_view name(nameBlob + nameOffsets[id], size_t(nameOffsets[id + 1] - nameOffsets[id]));
+        if (name.find(needle) == std::string_view::npos)
+            return;
+
+        std::string_view path(pathBlob + pathOffsets[id], size_t(pathOffsets[id + 1] - pathOffsets[id]));
+        if (path.substr(0, prefixView.size()) != prefixView)
+            return;
+        if (!recursive && path.find('/', prefixView.size()) != std::string_view::npos)
+            return;
+
+        QString result = QString::fromUtf8(path.data(), qsizetype(path.size()));
+        if (caseSensitive && !result.section('/', -1).contains(text, Qt::CaseSensitive))
+            return;
+        matches << result;
+    };
+
+    if (folded.size() < 3) {
+        for (quint64 id = 0; id < header->pathCount; ++id)
+            accept(quint32(id));
+    } else {
+        std::vector<quint32> queryTrigrams;
+        for (qsizetype i = 0; i + 3 <= folded.size(); ++i)
+            queryTrigrams.push_back(trigramAt(folded.constData() + i));
+        std::sort(queryTrigrams.begin(), queryTrigrams.end());
+        queryTrigrams.erase(std::unique(queryTrigrams.begin(), queryTrigrams.end()), queryTrigrams.end());
+
+        std::vector<const TrigramEntry*> lists;
+        const TrigramEntry* tableEnd = table + header->trigramCount;
+        for (quint32 trigram : queryTrigrams) {
+            const TrigramEntry* entry = std::lower_bound(table, tableEnd, trigram,
+                [](const TrigramEntry& e, quint32 t) { return e.trigram < t; });
+            if (entry == tableEnd || entry->trigram != trigram) {
+                lists.clear();
+                break;
+            }
+            lists.push_back(entry);
+        }
+
+        if (!lists.empty()) {
+            std::sort(lists.begin(), lists.end(),
+                      [](const TrigramEntry* a, const TrigramEntry* b) { return a->count < b->count; });
+
+            std::vector<quint32> candidates(postings + lists[0]->first, postings + lists[0]->first + lists[0]->count);
+            std::vector<quint32> narrowed;
+            for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+                const quint32* begin = postings + lists[i]->first;
+                narrowed.clear();
+                std::set_intersection(candidates.begin(), candidates.end(), begin, begin + lists[i]->count,
+                                      std::back_inserter(narrowed));
+                candidates.swap(narrowed);
+            }
+
+            for (quint32 id : candidates)
+                accept(id);
+        }
+    }
+
+    indexStats.lastQueryMicros = timer.nsecsElapsed() / 1000;
+    qCDebug(lcIndex) << "Index query" << text << "returned" << matches.size()
+                     << "paths in" << indexStats.lastQueryMicros << "us";
+    return matches;
+}
+
+QStringList FilenameIndex::fuzzyQuery(const QString& pattern, const QString& basePath, bool recursive, int limit) {
+    QStringList matches;
+    FuzzyMatcher matcher(pattern);
+    if (!mapped || !matcher.isValid())
+        return matches;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const IndexHeader* header = reinterpret_cast<const IndexHeader*>(mapped);
+    const quint64* pathOffsets = reinterpret_cast<const quint64*>(mapped + header->pathOffsetsOffset);
+    const char* pathBlob = reinterpret_cast<const char*>(mapped + header->pathBlobOffset);
+    const quint64* nameOffsets = reinterpret_cast<const quint64*>(mapped + header->nameOffsetsOffset);
+    const char* nameBlob = reinterpret_cast<const char*>(mapped + header->nameBlobOffset);
+
+    QByteArray prefix = QDir::cleanPath(basePath).toUtf8();
+    if (!prefix.endsWith('/'))
+        prefix += '/';
+    std::string_view prefixView(prefix.constData(), size_t(prefix.size()));
+
+    auto pathOf = [&](quint64 id) {
+        return std::string_view(pathBlob + pathOffsets[id], size_t(pathOffsets[id + 1] - pathOffsets[id]));
+    };
+    auto accept = [&](quint64 id) {
+        std::string_view path = pathOf(id);
+        if (path.substr(0, prefixView.size()) != prefixView)
+            return false;
+        return recursive || path.find('/', prefixView.size()) == std::string_view::npos;
+    };
+
+    std::vector<FuzzyMatcher::Candidate> ranked =
+        matcher.rank(nameBlob, nameOffsets, header->pathCount, limit, accept);
+    matches.reserve(qsizetype(ranked.size()));
+    for (const FuzzyMatcher::Candidate& candidate : ranked) {
+        std::string_view path = pathOf(candidate.id);
+        matches << QString::fromUtf8(path.data(), qsizetype(path.size()));
+    }
+
+    indexStats.lastQueryMicros = timer.nsecsElapsed() / 1000;
+    qCDebug(lcIndex) << "Fuzzy index query" << pattern << "returned" << matches.size()
+                     << "paths in" << indexStats.lastQueryMicros << "us";
+    return matches;
+}
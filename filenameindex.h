@@ -0,0 +1,83 @@
+#ifndef FILENAMEINDEX_H
+#define FILENAMEINDEX_H
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QFile>
+#include <atomic>
+
+class QThreadPool;
+
+class FilenameIndex : public QObject {
+    Q_OBJECT
+public:
+    struct Stats {
+        qint64 pathCount;
+        qint64 sizeOnDisk;
+        qint64 buildTimeMsecs;
+        qint64 lastQueryMicros;
+        QDateTime builtAt;
+    };
+
+    explicit FilenameIndex(QObject* parent = nullptr);
+    ~FilenameIndex();
+
+    void setRoots(const QStringList& roots);
+    QStringList roots() const { return indexRoots; }
+
+    void setMaxAge(qint64 seconds);
+
+    void setIndexPath(const QString& path);
+    QString indexPath() const { return indexFilePath; }
+
+    bool load();
+
+    void unload();
+
+    void rebuild();
+
+    bool isLoaded() const { return mapped != nullptr; }
+
+    bool isBuilding() const { return building; }
+
+    bool isStale() const;
+
+    // Whether path lies under the roots of a loaded, fresh-enough index. The index may still lag behind
+    // the disk there; directories() tells which folders a search has to check.
+    bool covers(const QString& path) const;
+
+    // The indexed folders a search of basePath reads: basePath itself, and with recursive every folder
+    // under it. Each maps to its modification time in msecs when it was indexed.
+    QHash<QString, qint64> directories(const QString& basePath, bool recursive) const;
+
+    QStringList query(const QString& text, const QString& basePath, bool recursive, bool caseSensitive);
+
+    QStringList fuzzyQuery(const QString& pattern, const QString& basePath, bool recursive, int limit);
+
+    Stats stats() const { return indexStats; }
+
+    static QString defaultIndexPath();
+
+signals:
+    void rebuilt();
+
+private:
+    QThreadPool* pool;
+    QFile file;
+    const uchar* mapped;
+    qint64 mappedSize;
+    QString indexFilePath;
+    QStringList indexRoots;
+    QStringList loadedRoots;
+    qint64 maxAgeSecs;
+    bool building;
+    std::atomic<bool> cancelBuild;
+    Stats indexStats;
+
+    void onBuildFinished(bool ok);
+};
+
+#endif
@@ -1,17 +1,38 @@
 #include "fileviewmodel.h"
+#include "directorymodel.h"
+#include "filterproxymodel.h"
+#include "gridview.h"
+#include "mounttable.h"
+#include "rowtextcache.h"
+#include "thumbnailloader.h"
 #include <QHeaderView>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QSettings>
 #include <QTimer>
 
 FileViewModel::FileViewModel(QObject* parent)
-    : QObject(parent), fileModel(nullptr), viewContainer(nullptr), 
+    : QObject(parent), fileModel(nullptr), compactModel(nullptr), listingModel(nullptr),
+    filterModel(nullptr), displayModel(nullptr), viewContainer(nullptr), 
     iconView(nullptr), listView(nullptr), detailsView(nullptr), 
-    tilesView(nullptr), contentView(nullptr), currentMode(ViewMode::Icons) {
+    tilesView(nullptr), contentView(nullptr), thumbnails(new ThumbnailLoader(this)), currentMode(ViewMode::Icons) {
     
-    fileModel = new QFileSystemModel(this);
-    fileModel->setFilter(QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files);
+    QSettings settings("Explosion", "Explosion");
+    if (settings.value("view/directoryModel", "compact").toString() == "compact") {
+        compactModel = new DirectoryModel(this);
+        listingModel = compactModel;
+        connect(compactModel, &DirectoryModel::directoryLoaded, this, &FileViewModel::directoryLoaded);
+    } else {
+        fileModel = new QFileSystemModel(this);
+        fileModel->setFilter(QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files);
+        fileModel->setReadOnly(false);
+        listingModel = fileModel;
+        connect(fileModel, &QFileSystemModel::directoryLoaded, this, &FileViewModel::directoryLoaded);
+    }
     
-    fileModel->setReadOnly(false);
+    filterModel = new FilterProxyModel(this);
+    filterModel->setSourceModel(listingModel);
+    displayModel = filterModel;
 }
 
 FileViewModel::~FileViewModel() {
@@ -22,44 +43,86 @@ void FileViewModel::setupFileSystem(QStackedWidget* container) {
     viewContainer = container;
     if (!viewContainer) return;
     
-    iconView = new QListView(viewContainer);
-    listView = new QListView(viewContainer);
-    detailsView = new QTableView(viewContainer);
-    tilesView = new QListView(viewContainer);
-    contentView = new QListView(viewContainer);
-    
-    detailsView->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
-    
-    configureIconView();
-    configureListView();
-    configureDetailsView();
-    configureTilesView();
-    configureContentView();
-    
-    viewContainer->addWidget(iconView);
-    viewContainer->addWidget(listView);
-    viewContainer->addWidget(detailsView);
-    viewContainer->addWidget(tilesView);
-    viewContainer->addWidget(contentView);
-    
-    iconView->setModel(fileModel);
-    listView->setModel(fileModel);
-    detailsView->setModel(fileModel);
-    tilesView->setModel(fileModel);
-    contentView->setModel(fileModel);
-    
-    iconView->setItemDelegate(new IconViewDelegate(this));
-    tilesView->setItemDelegate(new TilesViewDelegate(this));
-    contentView->setItemDelegate(new ContentViewDelegate(this));
+    setViewMode(currentMode);
+}
+
+// Views are built on first use; only the one on screen is bound to a model.
+QAbstractItemView* FileViewModel::viewForMode(ViewMode mode) {
+    switch (mode) {
+        case ViewMode::Icons:
+            if (!iconView) {
+                iconView = new GridView(viewContainer);
+                configureIconView();
+                attachView(iconView);
+            }
+            return iconView;
+        case ViewMode::List:
+            if (!listView) {
+                listView = new QListView(viewContainer);
+                configureListView();
+                attachView(listView);
+            }
+            return listView;
+        case ViewMode::Details:
+            if (!detailsView) {
+                detailsView = new QTableView(viewContainer);
+                configureDetailsView();
+                attachView(detailsView);
+            }
+            return detailsView;
+        case ViewMode::Tiles:
+            if (!tilesView) {
+                tilesView = new GridView(viewContainer);
+                configureTilesView();
+                attachView(tilesView);
+            }
+            return tilesView;
+        case ViewMode::Content:
+            if (!contentView) {
+                contentView = new QListView(viewContainer);
+                configureContentView();
+                attachView(contentView);
+            }
+            return contentView;
+    }
+    return nullptr;
+}
+
+QAbstractItemView* FileViewModel::currentView() const {
+    switch (currentMode) {
+        case ViewMode::Icons: return iconView;
+        case ViewMode::List: return listView;
+        case ViewMode::Details: return detailsView;
+        case ViewMode::Tiles: return tilesView;
+        case ViewMode::Content: return contentView;
+    }
+    return nullptr;
+}
+
+void FileViewModel::attachView(QAbstractItemView* view) {
+    view->setMouseTracking(true);
+    connect(view, &QAbstractItemView::entered, this, &FileViewModel::onItemEntered);
+    viewContainer->addWidget(view);
+}
+
+void FileViewModel::bindView(QAbstractItemView* view, QAbstractItemModel* model) {
+    if (view->model() == model)
+        return;
     
-    setViewMode(ViewMode::Icons);
+    // setModel() leaves the old selection model behind.
+    QItemSelectionModel* oldSelection = view->selectionModel();
+    view->setModel(model);
+    delete oldSelection;
 }
 
 void FileViewModel::setRootPath(const QString& path) {
-    if (!QFileInfo::exists(path)) return;
+    if (!MountTable::isSlowPath(path) && !QFileInfo::exists(path)) return;
     
     rootPath = path;
-    QModelIndex index = fileModel->setRootPath(path);
+    if (compactModel)
+        compactModel->setRootPath(path);
+    else
+        fileModel->setRootPath(path);
     
     updateCurrentViewRoot();
 }
@@ -69,33 +132,71 @@ QString FileViewModel::currentRootPath() const {
 }
 
 QModelIndex FileViewModel::indexForPath(const QString& path) const {
-    return fileModel->index(path);
+    if (compactModel) {
+        for (int row = 0; row < compactModel->rowCount(); ++row) {
+            QModelIndex index = compactModel->index(row, 0);
+            if (compactModel->filePath(index) == path)
+                return filterModel->mapFromSource(index);
+        }
+        return QModelIndex();
+    }
+    return filterModel->mapFromSource(fileModel->index(path));
+}
+
+QStringList FileViewModel::subfolderPaths(int limit) const {
+    QStringList paths;
+    if (!compactModel)
+        return paths;
+    
+    for (int row = 0; row < compactModel->rowCount() && paths.size() < limit; ++row) {
+        QModelIndex index = compactModel->index(row, 0);
+        if (compactModel->isDir(index))
+            paths.append(compactModel->filePath(index));
+    }
+    return paths;
+}
+
+void FileViewModel::prefetchDirectories(const QStringList& paths) {
+    if (compactModel)
+        compactModel->prefetch(paths);
+}
+
+// Only the compact listing model computes folder sizes; QFileSystemModel keeps its empty folder cells.
+void FileViewModel::setFolderSizesEnabled(bool enabled) {
+    QSettings settings("Explosion", "Explosion");
+    settings.setValue("view/folderSizes", enabled);
+    if (compactModel)
+        compactModel->setFolderSizesEnabled(enabled);
 }
 
 void FileViewModel::setViewMode(ViewMode mode) {
     if (!viewContainer) return;
     
+    QAbstractItemView* previous = currentView();
     currentMode = mode;
-    
-    switch (mode) {
-        case ViewMode::Icons:
-            viewContainer->setCurrentWidget(iconView);
-            break;
-        case ViewMode::List:
-            viewContainer->setCurrentWidget(listView);
-            break;
-        case ViewMode::Details:
-            viewContainer->setCurrentWidget(detailsView);
-            break;
-        case ViewMode::Tiles:
-            viewContainer->setCurrentWidget(tilesView);
-            break;
-        case ViewMode::Content:
-            viewContainer->setCurrentWidget(contentView);
-            break;
+    QAbstractItemView* view = viewForMode(mode);
+    
+    if (compactModel) {
+        int fields = 0;
+        // Icons shows no dates, but its thumbnails are keyed by them.
+        if (mode == ViewMode::Details)
+            fields = DirectoryModel::SizeField | DirectoryModel::ModifiedField;
+        else if (mode == ViewMode::Content || mode == ViewMode::Icons)
+            fields = DirectoryModel::ModifiedField;
+        compactModel->setMetadataFields(fields);
     }
     
+    // A hidden view keeps no model, so it pays nothing for rows arriving or navigation; it re-binds here.
+    if (previous && previous != view)
+        bindView(previous, nullptr);
+    bindView(view, displayModel);
+    viewContainer->setCurrentWidget(view);
+    
     updateCurrentViewRoot();
+    
+    if (mode == ViewMode::Details) {
+        QTimer::singleShot(0, this, &FileViewModel::redistributeColumnSpace);
+    }
 }
 
 void FileViewModel::configureIconView() {
@@ -103,11 +204,10 @@ void FileViewModel::configureIconView() {
     iconView->setIconSize(QSize(48, 48));
     iconView->setGridSize(QSize(120, 100));
     iconView->setSpacing(10);
-    iconView->setResizeMode(QListView::Adjust);
-    iconView->setWrapping(true);
-    iconView->setUniformItemSizes(true);
+    iconView->setFlow(QListView::LeftToRight);
+    iconView->setItemDelegate(new IconViewDelegate(thumbnails, this));
     
-    connect(iconView, &QListView::doubleClicked, this, &FileViewModel::onItemDoubleClicked);
+    connect(iconView, &GridView::doubleClicked, this, &FileViewModel::onItemDoubleClicked);
 }
 
 void FileViewModel::configureListView() {
@@ -136,6 +236,7 @@ void FileViewModel::configureListView() {
     }
     
     void FileViewModel::configureDetailsView() {
+        detailsView->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
         detailsView->setSelectionBehavior(QAbstractItemView::SelectRows);
         detailsView->setSelectionMode(QAbstractItemView::ExtendedSelection);
         detailsView->setSortingEnabled(true);
@@ -278,13 +379,11 @@ void FileViewModel::configureTilesView() {
     tilesView->setIconSize(QSize(32, 32));
     tilesView->setGridSize(QSize(300, 44)); 
     tilesView->setSpacing(2);
-    tilesView->setResizeMode(QListView::Adjust);
     
     tilesView->setFlow(QListView::TopToBottom);
-    tilesView->setWrapping(true);
-    tilesView->setUniformItemSizes(true);
+    tilesView->setItemDelegate(new TilesViewDelegate(this));
     
-    connect(tilesView, &QListView::doubleClicked, this, &FileViewModel::onItemDoubleClicked);
+    connect(tilesView, &GridView::doubleClicked, this, &FileViewModel::onItemDoubleClicked);
 }
 
 void FileViewModel::configureContentView() {
@@ -293,6 +392,7 @@ void FileViewModel::configureContentView() {
     contentView->setGridSize(QSize(400, 58)); 
     contentView->setSpacing(1);
     contentView->setUniformItemSizes(true);
+    contentView->setItemDelegate(new ContentViewDelegate(thumbnails, this));
     
     connect(contentView, &QListView::doubleClicked, this, &FileViewModel::onItemDoubleClicked);
 }
@@ -301,16 +401,52 @@ void FileViewModel::onItemDoubleClicked(const QModelIndex &index) {
     emit itemActivated(index);
 }
 
+// The listing already knows which entries are folders, so activating one needs no stat on the GUI thread.
+bool FileViewModel::isDirectory(const QModelIndex& index) const {
+    if (compactModel && displayModel == filterModel && index.model() == filterModel)
+        return compactModel->isDir(filterModel->mapToSource(index));
+    return QFileInfo(index.data(QFileSystemModel::FilePathRole).toString()).isDir();
+}
+
+void FileViewModel::onItemEntered(const QModelIndex& index) {
+    if (!compactModel || displayModel != filterModel)
+        return;
+    
+    QModelIndex sourceIndex = filterModel->mapToSource(index);
+    if (compactModel->isDir(sourceIndex))
+        emit directoryHovered(compactModel->filePath(sourceIndex));
+}
+
 void FileViewModel::updateCurrentViewRoot() {
-    if (rootPath.isEmpty()) return;
+    if (rootPath.isEmpty() || displayModel != filterModel) return;
+    
+    filterModel->setSourceRoot(compactModel ? QModelIndex() : fileModel->index(rootPath));
+}
+
+void FileViewModel::showSearchResults(QAbstractItemModel* resultsModel) {
+    if (!resultsModel || displayModel == resultsModel) return;
+    
+    setDisplayModel(resultsModel);
+}
+
+void FileViewModel::showDirectoryListing() {
+    if (displayModel == filterModel) return;
+    
+    setDisplayModel(filterModel);
+    updateCurrentViewRoot();
+}
+
+void FileViewModel::setDisplayModel(QAbstractItemModel* model) {
+    displayModel = model;
     
-    QModelIndex index = fileModel->index(rootPath);
+    if (!viewContainer) return;
+    
+    if (QAbstractItemView* view = currentView())
+        bindView(view, model);
     
-    iconView->setRootIndex(index);
-    listView->setRootIndex(index);
-    detailsView->setRootIndex(index);
-    tilesView->setRootIndex(index);
-    contentView->setRootIndex(index);
+    if (currentMode == ViewMode::Details) {
+        QTimer::singleShot(0, this, &FileViewModel::redistributeColumnSpace);
+    }
 }
 
 void FileViewModel::applySearchFilter(const QStringList& filters, bool hideNonMatching) {
@@ -319,25 +455,27 @@ void FileViewModel::applySearchFilter(const QStringList& filters, bool hideNonMa
         return;
     }
     
-    fileModel->setNameFilters(filters);
-    
-    fileModel->setNameFilterDisables(!hideNonMatching);
-    
-    QDir::Filters currentFilters = fileModel->filter();
-    if (!(currentFilters & QDir::AllDirs)) {
-        fileModel->setFilter(currentFilters | QDir::AllDirs);
-    }
+    filterModel->setNameFilters(filters, hideNonMatching);
 }
 
 void FileViewModel::clearFilters() {
-    fileModel->setNameFilters(QStringList());
-    fileModel->setNameFilterDisables(true);
+    filterModel->setNameFilters(QStringList(), false);
 }
 
-IconViewDelegate::IconViewDelegate(QObject *parent) : QStyledItemDelegate(parent) {
+IconViewDelegate::IconViewDelegate(ThumbnailLoader *thumbnails, QObject *parent)
+    : QStyledItemDelegate(parent), thumbnails(thumbnails) {
 }
 
-TilesViewDelegate::TilesViewDelegate(QObject *parent) : QStyledItemDelegate(parent) {
+void IconViewDelegate::initStyleOption(QStyleOptionViewItem *option, const QModelIndex &index) const {
+    QStyledItemDelegate::initStyleOption(option, index);
+    
+    QPixmap thumbnail = thumbnails->thumbnail(index, option->widget, option->decorationSize.width());
+    if (!thumbnail.isNull())
+        option->icon = QIcon(thumbnail);
+}
+
+TilesViewDelegate::TilesViewDelegate(QObject *parent)
+    : QStyledItemDelegate(parent), textCache(new RowTextCache("Tiles", -1, this)) {
 }
 
 void TilesViewDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const {
@@ -346,34 +484,44 @@ void TilesViewDelegate::paint(QPainter *painter, const QStyleOptionViewItem &opt
         return;
     }
     
-    QStyleOptionViewItem opt = option;
-    initStyleOption(&opt, index);
+    QElapsedTimer paintTimer;
+    paintTimer.start();
     
-    if (opt.state & QStyle::State_Selected) {
-        painter->fillRect(opt.rect, opt.palette.highlight());
+    if (option.state & QStyle::State_Selected) {
+        painter->fillRect(option.rect, option.palette.highlight());
     }
     
     QIcon icon = qvariant_cast<QIcon>(index.data(Qt::DecorationRole));
-    QString text = index.data(Qt::DisplayRole).toString();
     
-    QRect iconRect = opt.rect;
+    QRect iconRect = option.rect;
     iconRect.setSize(QSize(32, 32));
-    iconRect.moveTop(opt.rect.top() + (opt.rect.height() - 32) / 2);
-    iconRect.moveLeft(opt.rect.left() + 4);
+    iconRect.moveTop(option.rect.top() + (option.rect.height() - 32) / 2);
+    iconRect.moveLeft(option.rect.left() + 4);
     icon.paint(painter, iconRect);
     
-    if (opt.state & QStyle::State_Selected) {
-        painter->setPen(opt.palette.color(QPalette::HighlightedText));
+    if (option.state & QStyle::State_Selected) {
+        painter->setPen(option.palette.color(QPalette::HighlightedText));
     } else {
-        painter->setPen(opt.palette.color(QPalette::Text));
+        painter->setPen(option.palette.color(QPalette::Text));
     }
     
-    QRect textRect = opt.rect;
+    QRect textRect = option.rect;
     textRect.setLeft(iconRect.right() + 8);
-    textRect.setTop(opt.rect.top() + 2);
-    textRect.setHeight(opt.rect.height());
+    textRect.setTop(option.rect.top() + 2);
+    textRect.setHeight(option.rect.height());
+    
+    const RowTextCache::Row *row = textCache->find(index, option.rect.width(), painter->font());
+    if (!row) {
+        RowTextCache::Row laidOut;
+        laidOut.width = option.rect.width();
+        QString text = index.data(Qt::DisplayRole).toString();
+        laidOut.name = RowTextCache::layout(painter->fontMetrics().elidedText(text, Qt::ElideRight, textRect.width()),
+                                            painter->font());
+        row = textCache->insert(index, laidOut);
+    }
+    RowTextCache::draw(painter, textRect, row->name, Qt::AlignLeft);
     
-    painter->drawText(textRect, Qt::AlignVCenter | Qt::AlignLeft, text);
+    textCache->recordPaint(paintTimer.nsecsElapsed());
 }
 
 QSize TilesViewDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const {
@@ -382,7 +530,8 @@ QSize TilesViewDelegate::sizeHint(const QStyleOptionViewItem &option, const QMod
     return size;
 }
 
-ContentViewDelegate::ContentViewDelegate(QObject *parent) : QStyledItemDelegate(parent) {
+ContentViewDelegate::ContentViewDelegate(ThumbnailLoader *thumbnails, QObject *parent)
+    : QStyledItemDelegate(parent), thumbnails(thumbnails), textCache(new RowTextCache("Content", 3, this)) {
 }
 
 void ContentViewDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const {
@@ -391,49 +540,67 @@ void ContentViewDelegate::paint(QPainter *painter, const QStyleOptionViewItem &o
         return;
     }
     
-    QStyleOptionViewItem opt = option;
-    initStyleOption(&opt, index);
+    QElapsedTimer paintTimer;
+    paintTimer.start();
     
-    if (opt.state & QStyle::State_Selected) {
-        painter->fillRect(opt.rect, opt.palette.highlight());
+    if (option.state & QStyle::State_Selected) {
+        painter->fillRect(option.rect, option.palette.highlight());
     }
     
-    QIcon icon = qvariant_cast<QIcon>(index.data(Qt::DecorationRole));
-    QString text = index.data(Qt::DisplayRole).toString();
-    
-    QFileSystemModel *model = qobject_cast<QFileSystemModel*>(const_cast<QAbstractItemModel*>(index.model()));
-    QString dateModified;
-    if (model) {
-        QFileInfo fileInfo = model->fileInfo(index);
-        dateModified = fileInfo.lastModified().toString("M/d/yyyy h:mm AP");
-    }
+    QPixmap thumbnail = thumbnails->thumbnail(index, option.widget, 48);
+    QIcon icon = thumbnail.isNull() ? qvariant_cast<QIcon>(index.data(Qt::DecorationRole)) : QIcon(thumbnail);
     
-    QRect iconRect = opt.rect;
+    QRect iconRect = option.rect;
     iconRect.setSize(QSize(48, 48));
-    iconRect.moveTop(opt.rect.top() + (opt.rect.height() - 48) / 2);
-    iconRect.moveLeft(opt.rect.left() + 4);
+    iconRect.moveTop(option.rect.top() + (option.rect.height() - 48) / 2);
+    iconRect.moveLeft(option.rect.left() + 4);
     icon.paint(painter, iconRect);
     
-    if (opt.state & QStyle::State_Selected) {
-        painter->setPen(opt.palette.color(QPalette::HighlightedText));
+    if (option.state & QStyle::State_Selected) {
+        painter->setPen(option.palette.color(QPalette::HighlightedText));
     } else {
-        painter->setPen(opt.palette.color(QPalette::Text));
+        painter->setPen(option.palette.color(QPalette::Text));
     }
     
-    QRect textRect = opt.rect;
+    QRect textRect = option.rect;
     textRect.setLeft(iconRect.right() + 8);
-    textRect.setTop(opt.rect.top() + 10);
+    textRect.setTop(option.rect.top() + 10);
     textRect.setHeight(20);
-    textRect.setRight(opt.rect.right() - 150); 
+    textRect.setRight(option.rect.right() - 150); 
     
-    painter->drawText(textRect, Qt::AlignVCenter | Qt::AlignLeft, text);
-    
-    QRect dateRect = opt.rect;
-    dateRect.setLeft(opt.rect.right() - 140);
-    dateRect.setTop(opt.rect.top() + 10);
+    QRect dateRect = option.rect;
+    dateRect.setLeft(option.rect.right() - 140);
+    dateRect.setTop(option.rect.top() + 10);
     dateRect.setHeight(20);
     
-    painter->drawText(dateRect, Qt::AlignVCenter | Qt::AlignRight, "Date modified: " + dateModified);
+    const RowTextCache::Row *row = textCache->find(index, option.rect.width(), painter->font());
+    if (!row) {
+        QModelIndex sourceIndex = index;
+        if (auto *proxy = qobject_cast<const QAbstractProxyModel*>(index.model()))
+            sourceIndex = proxy->mapToSource(index);
+        const QFileSystemModel *model = qobject_cast<const QFileSystemModel*>(sourceIndex.model());
+        QString dateModified;
+        if (model) {
+            QFileInfo fileInfo = model->fileInfo(sourceIndex);
+            dateModified = fileInfo.lastModified().toString("M/d/yyyy h:mm AP");
+        } else {
+            dateModified = index.sibling(index.row(), 3).data(Qt::EditRole).toDateTime().toString("M/d/yyyy h:mm AP");
+        }
+        
+        QFontMetrics metrics = painter->fontMetrics();
+        RowTextCache::Row laidOut;
+        laidOut.width = option.rect.width();
+        laidOut.name = RowTextCache::layout(
+            metrics.elidedText(index.data(Qt::DisplayRole).toString(), Qt::ElideRight, textRect.width()),
+            painter->font());
+        laidOut.detail = RowTextCache::layout(
+            metrics.elidedText("Date modified: " + dateModified, Qt::ElideLeft, dateRect.width()), painter->font());
+        row = textCache->insert(index, laidOut);
+    }
+    RowTextCache::draw(painter, textRect, row->name, Qt::AlignLeft);
+    RowTextCache::draw(painter, dateRect, row->detail, Qt::AlignRight);
+    
+    textCache->recordPaint(paintTimer.nsecsElapsed());
 }
 
 QSize ContentViewDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const {
@@ -442,7 +609,8 @@ QSize ContentViewDelegate::sizeHint(const QStyleOptionViewItem &option, const QM
     return size;
 }
 
-ListViewDelegate::ListViewDelegate(QObject *parent) : QStyledItemDelegate(parent) {
+ListViewDelegate::ListViewDelegate(QObject *parent)
+    : QStyledItemDelegate(parent), textCache(new RowTextCache("List", -1, this)) {
 }
 
 void ListViewDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const {
@@ -451,35 +619,44 @@ void ListViewDelegate::paint(QPainter *painter, const QStyleOptionViewItem &opti
         return;
     }
     
-    QStyleOptionViewItem opt = option;
-    initStyleOption(&opt, index);
+    QElapsedTimer paintTimer;
+    paintTimer.start();
     
-    if (opt.state & QStyle::State_Selected) {
-        painter->fillRect(opt.rect, opt.palette.highlight());
+    if (option.state & QStyle::State_Selected) {
+        painter->fillRect(option.rect, option.palette.highlight());
     }
     
     QIcon icon = qvariant_cast<QIcon>(index.data(Qt::DecorationRole));
-    QString text = index.data(Qt::DisplayRole).toString();
     
-    QRect iconRect = opt.rect;
+    QRect iconRect = option.rect;
     iconRect.setSize(QSize(16, 16));
-    iconRect.moveTop(opt.rect.top() + (opt.rect.height() - 16) / 2);
-    iconRect.moveLeft(opt.rect.left() + 4);
+    iconRect.moveTop(option.rect.top() + (option.rect.height() - 16) / 2);
+    iconRect.moveLeft(option.rect.left() + 4);
     icon.paint(painter, iconRect);
     
-    if (opt.state & QStyle::State_Selected) {
-        painter->setPen(opt.palette.color(QPalette::HighlightedText));
+    if (option.state & QStyle::State_Selected) {
+        painter->setPen(option.palette.color(QPalette::HighlightedText));
     } else {
-        painter->setPen(opt.palette.color(QPalette::Text));
+        painter->setPen(option.palette.color(QPalette::Text));
     }
     
-    QRect textRect = opt.rect;
+    QRect textRect = option.rect;
     textRect.setLeft(iconRect.right() + 6);
-    textRect.setTop(opt.rect.top());
-    textRect.setHeight(opt.rect.height());
+    textRect.setTop(option.rect.top());
+    textRect.setHeight(option.rect.height());
+    
+    const RowTextCache::Row *row = textCache->find(index, option.rect.width(), painter->font());
+    if (!row) {
+        RowTextCache::Row laidOut;
+        laidOut.width = option.rect.width();
+        QString text = index.data(Qt::DisplayRole).toString();
+        laidOut.name = RowTextCache::layout(
+            painter->fontMetrics().elidedText(text, Qt::ElideRight, textRect.width() - 5), painter->font());
+        row = textCache->insert(index, laidOut);
+    }
+    RowTextCache::draw(painter, textRect, row->name, Qt::AlignLeft);
     
-    QString displayText = painter->fontMetrics().elidedText(text, Qt::ElideRight, textRect.width() - 5);
-    painter->drawText(textRect, Qt::AlignVCenter | Qt::AlignLeft, displayText);
+    textCache->recordPaint(paintTimer.nsecsElapsed());
 }
 
 QSize ListViewDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const {
@@ -13,6 +13,12 @@
 #include <QStyledItemDelegate>
 #include <QPainter>
 
+class DirectoryModel;
+class FilterProxyModel;
+class GridView;
+class RowTextCache;
+class ThumbnailLoader;
+
 enum class ViewMode {
     Icons,
     List,
@@ -24,7 +30,13 @@ enum class ViewMode {
 class IconViewDelegate : public QStyledItemDelegate {
     Q_OBJECT
 public:
-    explicit IconViewDelegate(QObject *parent = nullptr);
+    explicit IconViewDelegate(ThumbnailLoader *thumbnails, QObject *parent = nullptr);
+
+protected:
+    void initStyleOption(QStyleOptionViewItem *option, const QModelIndex &index) const override;
+
+private:
+    ThumbnailLoader *thumbnails;
 };
 
 class ListViewDelegate : public QStyledItemDelegate {
@@ -33,6 +45,9 @@ public:
     explicit ListViewDelegate(QObject *parent = nullptr);
     void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
     QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+private:
+    RowTextCache *textCache;
 };
 
 class TilesViewDelegate : public QStyledItemDelegate {
@@ -41,14 +56,21 @@ public:
     explicit TilesViewDelegate(QObject *parent = nullptr);
     void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
     QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+private:
+    RowTextCache *textCache;
 };
 
 class ContentViewDelegate : public QStyledItemDelegate {
     Q_OBJECT
 public:
-    explicit ContentViewDelegate(QObject *parent = nullptr);
+    explicit ContentViewDelegate(ThumbnailLoader *thumbnails, QObject *parent = nullptr);
     void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
     QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+private:
+    ThumbnailLoader *thumbnails;
+    RowTextCache *textCache;
 };
 
 class ResizableStackedWidget : public QStackedWidget {
@@ -82,19 +104,36 @@ public:
     
     QModelIndex indexForPath(const QString& path) const;
     
-    QFileSystemModel* model() const { return fileModel; }
+    QAbstractItemModel* model() const { return listingModel; }
     
     void applySearchFilter(const QStringList& filters, bool hideNonMatching);
     
     void clearFilters();
+    
+    void showSearchResults(QAbstractItemModel* resultsModel);
+    
+    void showDirectoryListing();
+    
+    bool isShowingSearchResults() const { return displayModel != filterModel; }
 
     void onContainerResized();
 
+    QStringList subfolderPaths(int limit) const;
+
+    void prefetchDirectories(const QStringList& paths);
+
+    void setFolderSizesEnabled(bool enabled);
+
+    bool isDirectory(const QModelIndex& index) const;
+
 signals:
     void itemActivated(const QModelIndex& index);
+    void directoryLoaded(const QString& path);
+    void directoryHovered(const QString& path);
 
 private slots:
     void onItemDoubleClicked(const QModelIndex& index);
+    void onItemEntered(const QModelIndex& index);
 
 private:
 
@@ -111,12 +150,17 @@ private:
     void redistributeColumnSpace();
     void ensureColumnsWithinView();
     QFileSystemModel* fileModel;
+    DirectoryModel* compactModel;
+    QAbstractItemModel* listingModel;
+    FilterProxyModel* filterModel;
+    QAbstractItemModel* displayModel;
     QStackedWidget* viewContainer;
-    QListView* iconView;
+    GridView* iconView;
     QListView* listView;
     QTableView* detailsView;
-    QListView* tilesView;
+    GridView* tilesView;
     QListView* contentView;
+    ThumbnailLoader* thumbnails;
     QString rootPath;
     ViewMode currentMode;
     
@@ -128,6 +172,11 @@ private:
     void configureTilesView();
     void configureContentView();
     void updateCurrentViewRoot();
+    void setDisplayModel(QAbstractItemModel* model);
+    QAbstractItemView* viewForMode(ViewMode mode);
+    QAbstractItemView* currentView() const;
+    void attachView(QAbstractItemView* view);
+    void bindView(QAbstractItemView* view, QAbstractItemModel* model);
 
 };
 
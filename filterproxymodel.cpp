@@ -0,0 +1,496 @@
+#include "filterproxymodel.h"
+#include "directorymodel.h"
+#include <QFileSystemModel>
+#include <algorithm>
+
+namespace {
+
+// Beyond this many separate row ranges a reset is cheaper for the views than one signal per range.
+const int MAX_RANGE_SIGNALS = 32;
+
+// SearchManager sends "*text*" followed by "*text*.ext" variants, which the first one already covers.
+QString containedTextOf(const QStringList& filters) {
+    if (filters.isEmpty())
+        return QString();
+
+    const QString& first = filters.first();
+    if (first.size() < 3 || !first.startsWith(QLatin1Char('*')) || !first.endsWith(QLatin1Char('*')))
+        return QString();
+
+    QString text = first.mid(1, first.size() - 2);
+    if (text.contains(QLatin1Char('*')) || text.contains(QLatin1Char('?')) || text.contains(QLatin1Char('[')))
+        return QString();
+
+    for (const QString& filter : filters) {
+        if (!filter.startsWith(first))
+            return QString();
+    }
+    return text;
+}
+
+}
+
+FilterProxyModel::FilterProxyModel(QObject* parent)
+    : QAbstractProxyModel(parent), hideNonMatching(true), hiding(false), removeFirst(0), removeEnd(0),
+      layoutPending(false) {
+}
+
+void FilterProxyModel::setSourceModel(QAbstractItemModel* model) {
+    beginResetModel();
+
+    if (sourceModel())
+        disconnect(sourceModel(), nullptr, this, nullptr);
+    QAbstractProxyModel::setSourceModel(model);
+
+    sourceRoot = QPersistentModelIndex();
+    matches.clear();
+    visible.clear();
+    hiding = false;
+
+    if (model) {
+        connect(model, &QAbstractItemModel::rowsAboutToBeInserted, this, &FilterProxyModel::onRowsAboutToBeInserted);
+        connect(model, &QAbstractItemModel::rowsInserted, this, &FilterProxyModel::onRowsInserted);
+        connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &FilterProxyModel::onRowsAboutToBeRemoved);
+        connect(model, &QAbstractItemModel::rowsRemoved, this, &FilterProxyModel::onRowsRemoved);
+        connect(model, &QAbstractItemModel::rowsAboutToBeMoved, this, &FilterProxyModel::onModelAboutToBeReset);
+        connect(model, &QAbstractItemModel::rowsMoved, this, &FilterProxyModel::onModelReset);
+        connect(model, &QAbstractItemModel::modelAboutToBeReset, this, &FilterProxyModel::onModelAboutToBeReset);
+        connect(model, &QAbstractItemModel::modelReset, this, &FilterProxyModel::onModelReset);
+        connect(model, &QAbstractItemModel::layoutAboutToBeChanged, this, &FilterProxyModel::onLayoutAboutToBeChanged);
+        connect(model, &QAbstractItemModel::layoutChanged, this, &FilterProxyModel::onLayoutChanged);
+        connect(model, &QAbstractItemModel::dataChanged, this, &FilterProxyModel::onDataChanged);
+        connect(model, &QAbstractItemModel::headerDataChanged, this, &FilterProxyModel::onHeaderDataChanged);
+    }
+
+    endResetModel();
+}
+
+void FilterProxyModel::setSourceRoot(const QModelIndex& root) {
+    if (sourceRoot == root)
+        return;
+
+    beginResetModel();
+    sourceRoot = root;
+    if (isFiltering()) {
+        evaluateAll();
+        if (hiding)
+            rebuildVisible();
+    }
+    endResetModel();
+}
+
+void FilterProxyModel::setNameFilters(const QStringList& filters, bool hide) {
+    if (filters == filterStrings && (filters.isEmpty() || hide == hideNonMatching))
+        return;
+
+    bool wasFiltering = isFiltering();
+    bool wasHiding = hiding;
+    QString previousText = containedText;
+
+    filterStrings = filters;
+    hideNonMatching = hide;
+    containedText = containedTextOf(filters);
+    textMatcher = QStringMatcher(containedText, Qt::CaseInsensitive);
+    filterPatterns.clear();
+    if (containedText.isEmpty()) {
+        for (const QString& filter : filters) {
+            filterPatterns.append(QRegularExpression(QRegularExpression::wildcardToRegularExpression(filter),
+                                                     QRegularExpression::CaseInsensitiveOption));
+        }
+    }
+
+    // Clearing never walks the rows: the proxy stops mapping and the views re-read only what they show.
+    if (filters.isEmpty()) {
+        if (wasHiding) {
+            beginResetModel();
+            hiding = false;
+            std::vector<int>().swap(visible);
+            matches.clear();
+            endResetModel();
+        } else {
+            matches.clear();
+            if (wasFiltering)
+                emitAllDataChanged();
+        }
+        return;
+    }
+
+    // A longer text can only drop rows and a shorter one can only add them, so only one side is re-tested.
+    bool comparable = wasFiltering && wasHiding && hide && !previousText.isEmpty() && !containedText.isEmpty();
+    if (comparable && containedText.contains(previousText, Qt::CaseInsensitive)) {
+        narrowVisible();
+        return;
+    }
+    if (comparable && previousText.contains(containedText, Qt::CaseInsensitive)) {
+        widenVisible();
+        return;
+    }
+
+    if (hide || wasHiding) {
+        beginResetModel();
+        evaluateAll();
+        hiding = hide;
+        if (hiding)
+            rebuildVisible();
+        else
+            std::vector<int>().swap(visible);
+        endResetModel();
+    } else {
+        evaluateAll();
+        emitAllDataChanged();
+    }
+}
+
+void FilterProxyModel::narrowVisible() {
+    std::vector<int> dropped;
+    for (size_t row = 0; row < visible.size(); ++row) {
+        if (!rowMatches(visible[row])) {
+            matches.clearBit(visible[row]);
+            dropped.push_back(int(row));
+        }
+    }
+    if (dropped.empty())
+        return;
+
+    int ranges = 1;
+    for (size_t i = 1; i < dropped.size(); ++i) {
+        if (dropped[i] != dropped[i - 1] + 1)
+            ++ranges;
+    }
+
+    if (ranges > MAX_RANGE_SIGNALS) {
+        beginResetModel();
+        rebuildVisible();
+        endResetModel();
+        return;
+    }
+
+    // Back to front, so removing one range leaves the proxy rows of the earlier ones unchanged.
+    size_t end = dropped.size();
+    while (end > 0) {
+        size_t begin = end - 1;
+        while (begin > 0 && dropped[begin - 1] == dropped[begin] - 1)
+            --begin;
+        beginRemoveRows(QModelIndex(), dropped[begin], dropped[end - 1]);
+        visible.erase(visible.begin() + dropped[begin], visible.begin() + dropped[end - 1] + 1);
+        endRemoveRows();
+        end = begin;
+    }
+}
+
+void FilterProxyModel::widenVisible() {
+    std::vector<int> added;
+    int count = sourceRowCount();
+    for (int row = 0; row < count; ++row) {
+        if (!matches.testBit(row) && rowMatches(row)) {
+            matches.setBit(row);
+            added.push_back(row);
+        }
+    }
+    if (added.empty())
+        return;
+
+    // Rows that land between the same two visible rows form one contiguous insertion.
+    std::vector<std::pair<size_t, size_t>> runs;
+    size_t position = 0;
+    for (size_t i = 0; i < added.size(); ++i) {
+        size_t at = size_t(std::lower_bound(visible.begin(), visible.end(), added[i]) - visible.begin());
+        if (runs.empty() || at != position)
+            runs.push_back({i, i + 1});
+        else
+            runs.back().second = i + 1;
+        position = at;
+    }
+
+    if (runs.size() > size_t(MAX_RANGE_SIGNALS)) {
+        beginResetModel();
+        rebuildVisible();
+        endResetModel();
+        return;
+    }
+
+    for (const auto& run : runs) {
+        int at = int(std::lower_bound(visible.begin(), visible.end(), added[run.first]) - visible.begin());
+        beginInsertRows(QModelIndex(), at, at + int(run.second - run.first) - 1);
+        visible.insert(visible.begin() + at, added.begin() + qptrdiff(run.first), added.begin() + qptrdiff(run.second));
+        endInsertRows();
+    }
+}
+
+int FilterProxyModel::sourceRowCount() const {
+    return sourceModel() ? sourceModel()->rowCount(sourceRoot) : 0;
+}
+
+bool FilterProxyModel::rowMatches(int sourceRow) const {
+    QModelIndex index = sourceModel()->index(sourceRow, 0, sourceRoot);
+
+    // Folders always stay visible so the user can keep navigating, as the old model-side filter did.
+    if (auto* directoryModel = qobject_cast<const DirectoryModel*>(sourceModel())) {
+        if (directoryModel->isDir(index))
+            return true;
+    } else if (auto* fileSystemModel = qobject_cast<const QFileSystemModel*>(sourceModel())) {
+        if (fileSystemModel->isDir(index))
+            return true;
+    }
+
+    QString name = index.data(QFileSystemModel::FileNameRole).toString();
+    if (!containedText.isEmpty())
+        return textMatcher.indexIn(name) >= 0;
+
+    for (const QRegularExpression& pattern : filterPatterns) {
+        if (pattern.match(name).hasMatch())
+            return true;
+    }
+    return false;
+}
+
+void FilterProxyModel::evaluateAll() {
+    int count = sourceRowCount();
+    matches.fill(false, count);
+    for (int row = 0; row < count; ++row) {
+        if (rowMatches(row))
+            matches.setBit(row);
+    }
+}
+
+void FilterProxyModel::rebuildVisible() {
+    visible.clear();
+    for (int row = 0; row < matches.size(); ++row) {
+        if (matches.testBit(row))
+            visible.push_back(row);
+    }
+}
+
+void FilterProxyModel::emitAllDataChanged() {
+    int rows = rowCount();
+    int columns = columnCount();
+    if (rows > 0 && columns > 0)
+        emit dataChanged(index(0, 0), index(rows - 1, columns - 1));
+}
+
+QModelIndex FilterProxyModel::mapToSource(const QModelIndex& proxyIndex) const {
+    if (!proxyIndex.isValid() || !sourceModel())
+        return QModelIndex();
+
+    int row = proxyIndex.row();
+    if (hiding) {
+        if (size_t(row) >= visible.size())
+            return QModelIndex();
+        row = visible[size_t(row)];
+    }
+    return sourceModel()->index(row, proxyIndex.column(), sourceRoot);
+}
+
+QModelIndex FilterProxyModel::mapFromSource(const QModelIndex& sourceIndex) const {
+    if (!sourceIndex.isValid() || !isSourceRoot(sourceIndex.parent()))
+        return QModelIndex();
+
+    int row = sourceIndex.row();
+    if (hiding) {
+        auto it = std::lower_bound(visible.begin(), visible.end(), row);
+        if (it == visible.end() || *it != row)
+            return QModelIndex();
+        row = int(it - visible.begin());
+    }
+    return createIndex(row, sourceIndex.column());
+}
+
+QModelIndex FilterProxyModel::index(int row, int column, const QModelIndex& parent) const {
+    if (parent.isValid() || row < 0 || column < 0 || row >= rowCount() || column >= columnCount())
+        return QModelIndex();
+    return createIndex(row, column);
+}
+
+QModelIndex FilterProxyModel::parent(const QModelIndex&) const {
+    return QModelIndex();
+}
+
+int FilterProxyModel::rowCount(const QModelIndex& parent) const {
+    if (parent.isValid())
+        return 0;
+    return hiding ? int(visible.size()) : sourceRowCount();
+}
+
+int FilterProxyModel::columnCount(const QModelIndex& parent) const {
+    if (parent.isValid() || !sourceModel())
+        return 0;
+    return sourceModel()->columnCount(sourceRoot);
+}
+
+bool FilterProxyModel::hasChildren(const QModelIndex& parent) const {
+    return !parent.isValid() && rowCount() > 0;
+}
+
+bool FilterProxyModel::canFetchMore(const QModelIndex& parent) const {
+    return !parent.isValid() && sourceModel() && sourceModel()->canFetchMore(sourceRoot);
+}
+
+void FilterProxyModel::fetchMore(const QModelIndex& parent) {
+    if (!parent.isValid() && sourceModel())
+        sourceModel()->fetchMore(sourceRoot);
+}
+
+Qt::ItemFlags FilterProxyModel::flags(const QModelIndex& index) const {
+    Qt::ItemFlags result = QAbstractProxyModel::flags(index);
+    if (index.isValid() && isFiltering() && !hiding) {
+        int row = mapToSource(index).row();
+        if (row >= 0 && row < matches.size() && !matches.testBit(row))
+            result &= ~Qt::ItemIsEnabled;
+    }
+    return result;
+}
+
+void FilterProxyModel::sort(int column, Qt::SortOrder order) {
+    if (sourceModel())
+        sourceModel()->sort(column, order);
+}
+
+void FilterProxyModel::onRowsAboutToBeInserted(const QModelIndex& parent, int first, int last) {
+    if (isSourceRoot(parent) && !hiding)
+        beginInsertRows(QModelIndex(), first, last);
+}
+
+void FilterProxyModel::onRowsInserted(const QModelIndex& parent, int first, int last) {
+    if (!isSourceRoot(parent))
+        return;
+
+    int count = last - first + 1;
+    if (isFiltering()) {
+        int oldSize = int(matches.size());
+        matches.resize(oldSize + count);
+        for (int row = oldSize - 1; row >= first; --row)
+            matches.setBit(row + count, matches.testBit(row));
+        for (int row = first; row <= last; ++row)
+            matches.setBit(row, rowMatches(row));
+    }
+
+    if (!hiding) {
+        endInsertRows();
+        return;
+    }
+
+    auto position = std::lower_bound(visible.begin(), visible.end(), first);
+    for (auto it = position; it != visible.end(); ++it)
+        *it += count;
+
+    std::vector<int> added;
+    for (int row = first; row <= last; ++row) {
+        if (matches.testBit(row))
+            added.push_back(row);
+    }
+    if (added.empty())
+        return;
+
+    int at = int(position - visible.begin());
+    beginInsertRows(QModelIndex(), at, at + int(added.size()) - 1);
+    visible.insert(visible.begin() + at, added.begin(), added.end());
+    endInsertRows();
+}
+
+void FilterProxyModel::onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last) {
+    if (!isSourceRoot(parent))
+        return;
+
+    if (!hiding) {
+        beginRemoveRows(QModelIndex(), first, last);
+        return;
+    }
+
+    removeFirst = int(std::lower_bound(visible.begin(), visible.end(), first) - visible.begin());
+    removeEnd = int(std::upper_bound(visible.begin(), visible.end(), last) - visible.begin());
+    if (removeFirst != removeEnd)
+        beginRemoveRows(QModelIndex(), removeFirst, removeEnd - 1);
+}
+
+void FilterProxyModel::onRowsRemoved(const QModelIndex& parent, int first, int last) {
+    if (!isSourceRoot(parent))
+        return;
+
+    int count = last - first + 1;
+    if (isFiltering()) {
+        int oldSize = int(matches.size());
+        for (int row = last + 1; row < oldSize; ++row)
+            matches.setBit(row - count, matches.testBit(row));
+        matches.resize(std::max(0, oldSize - count));
+    }
+
+    if (!hiding) {
+        endRemoveRows();
+        return;
+    }
+
+    visible.erase(visible.begin() + removeFirst, visible.begin() + removeEnd);
+    for (auto it = visible.begin() + removeFirst; it != visible.end(); ++it)
+        *it -= count;
+    if (removeFirst != removeEnd)
+        endRemoveRows();
+}
+
+void FilterProxyModel::onModelAboutToBeReset() {
+    beginResetModel();
+}
+
+void FilterProxyModel::onModelReset() {
+    if (isFiltering()) {
+        evaluateAll();
+        if (hiding)
+            rebuildVisible();
+    }
+    endResetModel();
+}
+
+void FilterProxyModel::onLayoutAboutToBeChanged(const QList<QPersistentModelIndex>& parents) {
+    if (!parents.isEmpty() && !parents.contains(sourceRoot))
+        return;
+
+    emit layoutAboutToBeChanged();
+    layoutPending = true;
+    layoutProxyIndexes = persistentIndexList();
+    layoutSourceIndexes.clear();
+    for (const QModelIndex& proxyIndex : std::as_const(layoutProxyIndexes))
+        layoutSourceIndexes.append(QPersistentModelIndex(mapToSource(proxyIndex)));
+}
+
+void FilterProxyModel::onLayoutChanged(const QList<QPersistentModelIndex>&) {
+    if (!layoutPending)
+        return;
+    layoutPending = false;
+
+    // The bitmap is keyed by source row, so a re-sorted source has to be matched again.
+    if (isFiltering()) {
+        evaluateAll();
+        if (hiding)
+            rebuildVisible();
+    }
+
+    QModelIndexList updated;
+    updated.reserve(layoutSourceIndexes.size());
+    for (const QPersistentModelIndex& sourceIndex : std::as_const(layoutSourceIndexes))
+        updated.append(mapFromSource(sourceIndex));
+    changePersistentIndexList(layoutProxyIndexes, updated);
+
+    layoutProxyIndexes.clear();
+    layoutSourceIndexes.clear();
+    emit layoutChanged();
+}
+
+void FilterProxyModel::onDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight,
+                                     const QList<int>& roles) {
+    if (!topLeft.isValid() || !isSourceRoot(topLeft.parent()))
+        return;
+
+    int first = topLeft.row();
+    int last = bottomRight.row();
+    if (hiding) {
+        first = int(std::lower_bound(visible.begin(), visible.end(), topLeft.row()) - visible.begin());
+        last = int(std::upper_bound(visible.begin(), visible.end(), bottomRight.row()) - visible.begin()) - 1;
+        if (first > last)
+            return;
+    }
+    emit dataChanged(index(first, topLeft.column()), index(last, bottomRight.column()), roles);
+}
+
+void FilterProxyModel::onHeaderDataChanged(Qt::Orientation orientation, int first, int last) {
+    if (orientation == Qt::Horizontal)
+        emit headerDataChanged(orientation, first, last);
+}
@@ -0,0 +1,88 @@
+#ifndef FILTERPROXYMODEL_H
+#define FILTERPROXYMODEL_H
+
+#include <QAbstractProxyModel>
+#include <QBitArray>
+#include <QPersistentModelIndex>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QStringMatcher>
+#include <QVector>
+#include <vector>
+
+// Flat view of one folder of the listing model with the quick-search name filters applied on top.
+// The source is never touched: a per-row match bitmap picks the rows to show, and without a filter
+// rows map through one to one.
+class FilterProxyModel : public QAbstractProxyModel {
+    Q_OBJECT
+public:
+    explicit FilterProxyModel(QObject* parent = nullptr);
+
+    void setSourceModel(QAbstractItemModel* model) override;
+
+    void setSourceRoot(const QModelIndex& root);
+
+    void setNameFilters(const QStringList& filters, bool hideNonMatching);
+    QStringList nameFilters() const { return filterStrings; }
+
+    bool isFiltering() const { return !filterStrings.isEmpty(); }
+
+    QModelIndex mapToSource(const QModelIndex& proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex& sourceIndex) const override;
+
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex& child) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex& parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+private slots:
+    void onRowsAboutToBeInserted(const QModelIndex& parent, int first, int last);
+    void onRowsInserted(const QModelIndex& parent, int first, int last);
+    void onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+    void onRowsRemoved(const QModelIndex& parent, int first, int last);
+    void onModelAboutToBeReset();
+    void onModelReset();
+    void onLayoutAboutToBeChanged(const QList<QPersistentModelIndex>& parents);
+    void onLayoutChanged(const QList<QPersistentModelIndex>& parents);
+    void onDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QList<int>& roles);
+    void onHeaderDataChanged(Qt::Orientation orientation, int first, int last);
+
+private:
+    QPersistentModelIndex sourceRoot;
+
+    QStringList filterStrings;
+    QVector<QRegularExpression> filterPatterns;
+    // Set when the filters reduce to "name contains text", which is what quick search sends.
+    QString containedText;
+    QStringMatcher textMatcher;
+    bool hideNonMatching;
+
+    // matches is indexed by source row; visible lists the shown source rows in ascending order
+    // and is only used while non-matching rows are hidden.
+    QBitArray matches;
+    std::vector<int> visible;
+    bool hiding;
+
+    int removeFirst;
+    int removeEnd;
+
+    bool layoutPending;
+    QModelIndexList layoutProxyIndexes;
+    QList<QPersistentModelIndex> layoutSourceIndexes;
+
+    bool isSourceRoot(const QModelIndex& parent) const { return sourceRoot == parent; }
+    int sourceRowCount() const;
+    bool rowMatches(int sourceRow) const;
+    void evaluateAll();
+    void rebuildVisible();
+    void narrowVisible();
+    void widenVisible();
+    void emitAllDataChanged();
+};
+
+#endif
@@ -0,0 +1,318 @@
+#include "foldersizescanner.h"
+#include <QByteArray>
+#include <QCache>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/ioprio.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+const int PUBLISH_INTERVAL_MS = 100;
+const size_t DIRENT_BUFFER_SIZE = 64 * 1024;
+const qint64 CACHE_BUDGET_BYTES = 32 * 1024 * 1024;
+const unsigned int FOLDER_STATX_MASK = STATX_TYPE | STATX_BLOCKS | STATX_MTIME | STATX_INO;
+const unsigned int ENTRY_STATX_MASK = STATX_TYPE | STATX_BLOCKS | STATX_INO | STATX_NLINK;
+
+struct LinkedFile {
+    quint64 inode;
+    qint64 bytes;
+};
+
+// What one folder holds directly. It only changes when the folder's mtime does, so an unchanged folder is
+// summed from here without reading it again; its subfolders are still visited to check their own mtimes.
+struct DirectoryRecord {
+    quint64 inode;
+    qint64 mtimeNsecs;
+    qint64 bytes;
+    std::vector<LinkedFile> links;
+    std::vector<QByteArray> subfolders;
+
+    qint64 cost() const {
+        qint64 total = qint64(sizeof(DirectoryRecord) + links.capacity() * sizeof(LinkedFile));
+        for (const QByteArray& name : subfolders)
+            total += qint64(sizeof(QByteArray)) + name.capacity();
+        return total;
+    }
+};
+
+struct FolderProgress {
+    std::atomic<qint64> bytes{0};
+    std::atomic<bool> complete{false};
+    std::atomic<bool> partial{false};
+    // Last values handed to the GUI; only touched there.
+    qint64 publishedBytes = 0;
+    bool publishedComplete = false;
+    bool publishedPartial = false;
+};
+
+inline qint64 blockBytes(const struct statx& stx) {
+    return qint64(stx.stx_blocks) * 512;
+}
+
+inline qint64 mtimeOf(const struct statx& stx) {
+    return qint64(stx.stx_mtime.tv_sec) * 1000000000 + stx.stx_mtime.tv_nsec;
+}
+
+inline quint64 deviceOf(const struct statx& stx) {
+    return (quint64(stx.stx_dev_major) << 32) | stx.stx_dev_minor;
+}
+
+}
+
+struct FolderSizeCache {
+    QMutex mutex;
+    QCache<QByteArray, DirectoryRecord> records;
+};
+
+struct FolderSizeJob {
+    explicit FolderSizeJob(qsizetype count) : folders(size_t(count)) {}
+
+    QByteArray root;
+    QVector<QByteArray> names;
+    std::vector<FolderProgress> folders;
+    std::atomic<bool> cancelled{false};
+    std::atomic<int> remaining{0};
+
+    // Hard links are counted under the first folder that reaches them.
+    QMutex linkMutex;
+    QSet<QPair<quint64, quint64>> seenLinks;
+};
+
+namespace {
+
+struct ScanState {
+    FolderSizeJob& job;
+    FolderSizeCache& cache;
+    FolderProgress& progress;
+    quint64 device;
+    std::vector<char> buffer;
+};
+
+bool readDirectory(ScanState& state, int fd, DirectoryRecord& record) {
+    record.bytes = 0;
+    while (!state.job.cancelled.load(std::memory_order_relaxed)) {
+        long got = ::syscall(SYS_getdents64, fd, state.buffer.data(), state.buffer.size());
+        if (got < 0) {
+            state.progress.partial = true;
+            return false;
+        }
+        if (got == 0)
+            return true;
+
+        // linux_dirent64: d_ino (8), d_off (8), d_reclen (2), d_type (1), d_name.
+        for (long offset = 0; offset < got;) {
+            const char* entry = state.buffer.data() + offset;
+            unsigned short recordLength;
+            std::memcpy(&recordLength, entry + 16, sizeof(recordLength));
+            const char* name = entry + 19;
+            offset += recordLength;
+
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                continue;
+            if (uchar(entry[18]) == DT_DIR) {
+                record.subfolders.emplace_back(name);
+                continue;
+            }
+
+            struct statx stx;
+            if (::statx(fd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_SYNC_AS_STAT, ENTRY_STATX_MASK, &stx) != 0) {
+                // Deleted since it was listed is not an error.
+                if (errno != ENOENT)
+                    state.progress.partial = true;
+                continue;
+            }
+            if (S_ISDIR(stx.stx_mode))
+                record.subfolders.emplace_back(name);
+            else if (stx.stx_nlink > 1)
+                record.links.push_back({quint64(stx.stx_ino), blockBytes(stx)});
+            else
+                record.bytes += blockBytes(stx);
+        }
+    }
+    return false;
+}
+
+// Counts what one folder holds directly and queues its subfolders on pending.
+void scanDirectory(ScanState& state, int fd, const QByteArray& path, const struct statx& self,
+                   std::vector<QByteArray>& pending) {
+    DirectoryRecord record;
+    bool cached = false;
+    {
+        QMutexLocker locker(&state.cache.mutex);
+        const DirectoryRecord* known = state.cache.records.object(path);
+        if (known && known->inode == self.stx_ino && known->mtimeNsecs == mtimeOf(self)) {
+            record = *known;
+            cached = true;
+        }
+    }
+
+    if (!cached) {
+        if (!readDirectory(state, fd, record))
+            return;
+        record.inode = self.stx_ino;
+        record.mtimeNsecs = mtimeOf(self);
+        QMutexLocker locker(&state.cache.mutex);
+        state.cache.records.insert(path, new DirectoryRecord(record), record.cost());
+    }
+
+    qint64 bytes = record.bytes;
+    if (!record.links.empty()) {
+        QMutexLocker locker(&state.job.linkMutex);
+        for (const LinkedFile& link : record.links) {
+            if (!state.job.seenLinks.contains({state.device, link.inode})) {
+                state.job.seenLinks.insert({state.device, link.inode});
+                bytes += link.bytes;
+            }
+        }
+    }
+    state.progress.bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+    for (const QByteArray& name : record.subfolders)
+        pending.push_back(path + '/' + name);
+}
+
+// Walks the tree from an explicit stack, holding one descriptor at a time, so a deep tree cannot run the
+// process out of them.
+void scanTree(ScanState& state, int fd, const QByteArray& path, const struct statx& self) {
+    std::vector<QByteArray> pending;
+    scanDirectory(state, fd, path, self, pending);
+
+    while (!pending.empty() && !state.job.cancelled.load(std::memory_order_relaxed)) {
+        QByteArray folder = std::move(pending.back());
+        pending.pop_back();
+
+        int child = ::open(folder.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (child < 0) {
+            if (errno != ENOENT)
+                state.progress.partial = true;
+            continue;
+        }
+        struct statx stx;
+        if (::statx(child, "", AT_EMPTY_PATH | AT_STATX_SYNC_AS_STAT, FOLDER_STATX_MASK, &stx) != 0) {
+            state.progress.partial = true;
+        } else if (deviceOf(stx) == state.device) {
+            state.progress.bytes.fetch_add(blockBytes(stx), std::memory_order_relaxed);
+            scanDirectory(state, child, folder, stx, pending);
+        }
+        ::close(child);
+    }
+}
+
+void scanFolder(FolderSizeJob& job, FolderSizeCache& cache, int folder) {
+    FolderProgress& progress = job.folders[size_t(folder)];
+    QByteArray path = job.root + '/' + job.names[folder];
+
+    // Symlinked folders are left alone like du does; their targets are counted where they live.
+    int fd = ::open(path.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    struct statx stx;
+    if (fd < 0 || ::statx(fd, "", AT_EMPTY_PATH | AT_STATX_SYNC_AS_STAT, FOLDER_STATX_MASK, &stx) != 0) {
+        progress.bytes = -1;
+    } else {
+        ScanState state{job, cache, progress, deviceOf(stx), std::vector<char>(DIRENT_BUFFER_SIZE)};
+        progress.bytes.fetch_add(blockBytes(stx), std::memory_order_relaxed);
+        scanTree(state, fd, path, stx);
+    }
+    if (fd >= 0)
+        ::close(fd);
+    progress.complete = true;
+}
+
+}
+
+FolderSizeScanner::FolderSizeScanner(QObject* parent)
+    : QObject(parent), pool(new QThreadPool(this)), publishTimer(new QTimer(this)), cache(new FolderSizeCache) {
+    pool->setMaxThreadCount(2);
+    pool->setThreadPriority(QThread::LowestPriority);
+    cache->records.setMaxCost(CACHE_BUDGET_BYTES);
+
+    publishTimer->setInterval(PUBLISH_INTERVAL_MS);
+    connect(publishTimer, &QTimer::timeout, this, &FolderSizeScanner::publish);
+}
+
+FolderSizeScanner::~FolderSizeScanner() {
+    cancel();
+    pool->waitForDone();
+}
+
+void FolderSizeScanner::start(const QString& rootPath, const QStringList& names) {
+    cancel();
+    if (names.isEmpty())
+        return;
+
+    auto current = std::make_shared<FolderSizeJob>(names.size());
+    current->root = QFile::encodeName(rootPath);
+    for (const QString& name : names)
+        current->names.append(QFile::encodeName(name));
+    current->remaining = int(names.size());
+    job = current;
+
+    FolderSizeCache* records = cache.get();
+    for (int folder = 0; folder < names.size(); ++folder) {
+        pool->start([current, records, folder]() {
+            if (!current->cancelled.load()) {
+                // ioprio_set(2) has no glibc wrapper; with IOPRIO_WHO_PROCESS a zero id means the calling thread.
+                ::syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0));
+                scanFolder(*current, *records, folder);
+            }
+            current->remaining.fetch_sub(1);
+        });
+    }
+    publishTimer->start();
+}
+
+void FolderSizeScanner::cancel() {
+    if (!job)
+        return;
+
+    job->cancelled = true;
+    job.reset();
+    publishTimer->stop();
+}
+
+void FolderSizeScanner::publish() {
+    std::shared_ptr<FolderSizeJob> current = job;
+    if (!current)
+        return;
+
+    // Read before the totals, so a scan that ends in between is still published complete next time.
+    bool done = current->remaining.load() == 0;
+
+    QVector<FolderSize> updates;
+    for (size_t folder = 0; folder < current->folders.size(); ++folder) {
+        FolderProgress& progress = current->folders[folder];
+        bool complete = progress.complete.load();
+        bool partial = progress.partial.load();
+        qint64 bytes = progress.bytes.load(std::memory_order_relaxed);
+        if (bytes == progress.publishedBytes && complete == progress.publishedComplete &&
+            partial == progress.publishedPartial)
+            continue;
+        progress.publishedBytes = bytes;
+        progress.publishedComplete = complete;
+        progress.publishedPartial = partial;
+        updates.append({int(folder), bytes, complete, partial});
+    }
+
+    if (!updates.isEmpty())
+        emit sizesUpdated(updates);
+
+    if (done) {
+        publishTimer->stop();
+        job.reset();
+        emit finished();
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef FOLDERSIZESCANNER_H
+#define FOLDERSIZESCANNER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+
+class QThreadPool;
+class QTimer;
+struct FolderSizeJob;
+struct FolderSizeCache;
+
+struct FolderSize {
+    int folder;
+    // Allocated bytes found so far, or -1 when the folder could not be opened.
+    qint64 bytes;
+    bool complete;
+    // Some of its contents could not be read, so bytes is a lower bound.
+    bool partial;
+};
+
+// Recursive disk usage of the subfolders of one folder, computed on a background pool. Like du, totals
+// count allocated blocks, stay on the folder's filesystem and count a hard-linked file once. Like du, a
+// subfolder that cannot be read is skipped and the total is flagged as partial.
+class FolderSizeScanner : public QObject {
+    Q_OBJECT
+public:
+    explicit FolderSizeScanner(QObject* parent = nullptr);
+    ~FolderSizeScanner();
+
+    // Folders are scanned in the order given; updates refer to them by their position in names.
+    void start(const QString& rootPath, const QStringList& names);
+
+    void cancel();
+
+    bool isRunning() const { return job != nullptr; }
+
+signals:
+    void sizesUpdated(const QVector<FolderSize>& sizes);
+
+    void finished();
+
+private:
+    QThreadPool* pool;
+    QTimer* publishTimer;
+    std::shared_ptr<FolderSizeJob> job;
+    std::unique_ptr<FolderSizeCache> cache;
+
+    void publish();
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include "fuzzymatcher.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const int SCORE_MATCH = 16;
+const int PENALTY_GAP_START = 3;
+const int PENALTY_GAP_EXTENSION = 1;
+const int BONUS_BOUNDARY = 8;
+const int BONUS_NON_WORD = 6;
+const int BONUS_CONSECUTIVE = 4;
+const int FIRST_CHAR_MULTIPLIER = 2;
+
+inline bool isWordByte(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || uchar(c) >= 0x80;
+}
+
+int boundaryBonus(const char* name, qsizetype i) {
+    if (i == 0)
+        return BONUS_BOUNDARY;
+    char previous = name[i - 1];
+    if (previous == ' ' || previous == '-' || previous == '_' || previous == '.' || previous == '/')
+        return BONUS_BOUNDARY;
+    if (!isWordByte(previous))
+        return BONUS_NON_WORD;
+    if (name[i] >= '0' && name[i] <= '9' && !(previous >= '0' && previous <= '9'))
+        return BONUS_NON_WORD;
+    return 0;
+}
+
+bool ranksHigher(const FuzzyMatcher::Candidate& a, const FuzzyMatcher::Candidate& b) {
+    if (a.score != b.score)
+        return a.score > b.score;
+    if (a.length != b.length)
+        return a.length < b.length;
+    return a.id < b.id;
+}
+
+}
+
+FuzzyMatcher::FuzzyMatcher(const QString& pattern)
+    : needle(fold(QString(pattern).remove(QLatin1Char(' ')))) {
+}
+
+QByteArray FuzzyMatcher::fold(const QString& text) {
+    return text.toLower().toUtf8();
+}
+
+int FuzzyMatcher::score(const QString& name) const {
+    QByteArray folded = fold(name);
+    return score(folded.constData(), folded.size());
+}
+
+int FuzzyMatcher::score(const char* name, qsizetype length) const {
+    const char* pattern = needle.constData();
+    qsizetype patternLength = needle.size();
+    if (patternLength == 0)
+        return 0;
+    if (patternLength > length)
+        return NoMatch;
+
+    // Greedy forward pass finds where the earliest complete match ends; memchr keeps it vectorized.
+    const char* position = name;
+    const char* end = name + length;
+    for (qsizetype j = 0; j < patternLength; ++j) {
+        const void* hit = std::memchr(position, pattern[j], size_t(end - position));
+        if (!hit)
+            return NoMatch;
+        position = static_cast<const char*>(hit) + 1;
+    }
+    qsizetype last = position - name - 1;
+
+    // Backward pass from that end gives the tightest window containing the subsequence.
+    qsizetype first = last;
+    for (qsizetype i = last, j = patternLength - 1; i >= 0; --i) {
+        if (name[i] == pattern[j]) {
+            if (j == 0) {
+                first = i;
+                break;
+            }
+            --j;
+        }
+    }
+
+    int total = 0;
+    int consecutive = 0;
+    bool inGap = false;
+    for (qsizetype i = first, j = 0; i <= last; ++i) {
+        if (j < patternLength && name[i] == pattern[j]) {
+            int bonus = boundaryBonus(name, i);
+            if (consecutive > 0)
+                bonus = std::max(bonus, BONUS_CONSECUTIVE);
+            if (j == 0)
+                bonus *= FIRST_CHAR_MULTIPLIER;
+            total += SCORE_MATCH + bonus;
+            ++consecutive;
+            inGap = false;
+            ++j;
+        } else {
+            total -= inGap ? PENALTY_GAP_EXTENSION : PENALTY_GAP_START;
+            inGap = true;
+            consecutive = 0;
+        }
+    }
+    return total;
+}
+
+std::vector<FuzzyMatcher::Candidate> FuzzyMatcher::rank(const char* blob, const quint64* offsets, quint64 count,
+                                                       int limit, const std::function<bool(quint64)>& accept) const {
+    std::vector<Candidate> best;
+    if (count == 0 || !isValid())
+        return best;
+
+    size_t capacity = limit > 0 ? size_t(limit) : 0;
+    if (capacity)
+        best.reserve(capacity);
+
+    const char* blobEnd = blob + offsets[count];
+    char lead = needle[0];
+    quint64 id = 0;
+
+    while (id < count) {
+        // Skip straight to the next name that contains the first pattern byte.
+        const char* from = blob + offsets[id];
+        const void* hit = std::memchr(from, lead, size_t(blobEnd - from));
+        if (!hit)
+            break;
+        quint64 at = quint64(static_cast<const char*>(hit) - blob);
+        while (offsets[id + 1] <= at)
+            ++id;
+
+        quint32 length = quint32(offsets[id + 1] - offsets[id]);
+        int value = score(blob + offsets[id], length);
+        Candidate candidate{id, value, length};
+        ++id;
+
+        if (value == NoMatch)
+            continue;
+        if (capacity && best.size() == capacity && !ranksHigher(candidate, best.front()))
+            continue;
+        if (accept && !accept(candidate.id))
+            continue;
+
+        if (!capacity) {
+            best.push_back(candidate);
+        } else if (best.size() < capacity) {
+            best.push_back(candidate);
+            std::push_heap(best.begin(), best.end(), ranksHigher);
+        } else {
+            std::pop_heap(best.begin(), best.end(), ranksHigher);
+            best.back() = candidate;
+            std::push_heap(best.begin(), best.end(), ranksHigher);
+        }
+    }
+
+    if (capacity)
+        std::sort_heap(best.begin(), best.end(), ranksHigher);
+    else
+        std::sort(best.begin(), best.end(), ranksHigher);
+    return best;
+}
@@ -0,0 +1,38 @@
+#ifndef FUZZYMATCHER_H
+#define FUZZYMATCHER_H
+
+#include <QByteArray>
+#include <QString>
+#include <functional>
+#include <limits>
+#include <vector>
+
+class FuzzyMatcher {
+public:
+    struct Candidate {
+        quint64 id;
+        int score;
+        quint32 length;
+    };
+
+    static const int NoMatch = std::numeric_limits<int>::min();
+
+    FuzzyMatcher() = default;
+    explicit FuzzyMatcher(const QString& pattern);
+
+    bool isValid() const { return !needle.isEmpty(); }
+
+    int score(const char* name, qsizetype length) const;
+
+    int score(const QString& name) const;
+
+    std::vector<Candidate> rank(const char* blob, const quint64* offsets, quint64 count, int limit,
+                                const std::function<bool(quint64)>& accept = {}) const;
+
+    static QByteArray fold(const QString& text);
+
+private:
+    QByteArray needle;
+};
+
+#endif
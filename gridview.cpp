@@ -0,0 +1,352 @@
+#include "gridview.h"
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+GridView::GridView(QWidget* parent)
+    : QAbstractItemView(parent), grid(100, 100), space(0), itemFlow(QListView::LeftToRight),
+      mode(QListView::IconMode) {
+}
+
+void GridView::setGridSize(const QSize& size) {
+    grid = size.expandedTo(QSize(1, 1));
+    scheduleDelayedItemsLayout();
+}
+
+void GridView::setSpacing(int spacing) {
+    space = qMax(0, spacing);
+    viewport()->update();
+}
+
+void GridView::setFlow(QListView::Flow flow) {
+    itemFlow = flow;
+    scheduleDelayedItemsLayout();
+}
+
+void GridView::setViewMode(QListView::ViewMode viewMode) {
+    mode = viewMode;
+    viewport()->update();
+}
+
+int GridView::itemCount() const {
+    return model() ? model()->rowCount(rootIndex()) : 0;
+}
+
+int GridView::lineLength() const {
+    if (itemFlow == QListView::LeftToRight)
+        return qMax(1, viewport()->width() / grid.width());
+    return qMax(1, viewport()->height() / grid.height());
+}
+
+QRect GridView::cellRect(int row) const {
+    int length = lineLength();
+    int line = row / length;
+    int slot = row % length;
+    if (itemFlow == QListView::LeftToRight)
+        return QRect(slot * grid.width(), line * grid.height(), grid.width(), grid.height());
+    return QRect(line * grid.width(), slot * grid.height(), grid.width(), grid.height());
+}
+
+int GridView::cellAt(const QPoint& contentPoint) const {
+    if (contentPoint.x() < 0 || contentPoint.y() < 0)
+        return -1;
+
+    int length = lineLength();
+    int column = contentPoint.x() / grid.width();
+    int line = contentPoint.y() / grid.height();
+    int row;
+    if (itemFlow == QListView::LeftToRight) {
+        if (column >= length)
+            return -1;
+        row = line * length + column;
+    } else {
+        if (line >= length)
+            return -1;
+        row = column * length + line;
+    }
+    return row < itemCount() ? row : -1;
+}
+
+void GridView::visibleRange(const QRect& contentRect, int* first, int* last) const {
+    int length = lineLength();
+    int firstLine, lastLine;
+    if (itemFlow == QListView::LeftToRight) {
+        firstLine = qMax(0, contentRect.top() / grid.height());
+        lastLine = qMax(0, contentRect.bottom() / grid.height());
+    } else {
+        firstLine = qMax(0, contentRect.left() / grid.width());
+        lastLine = qMax(0, contentRect.right() / grid.width());
+    }
+
+    *first = firstLine * length;
+    *last = qMin(itemCount() - 1, (lastLine + 1) * length - 1);
+}
+
+QModelIndex GridView::indexForRow(int row) const {
+    return model()->index(row, 0, rootIndex());
+}
+
+QRect GridView::visualRect(const QModelIndex& index) const {
+    if (!index.isValid() || index.parent() != rootIndex())
+        return QRect();
+
+    int before = space / 2;
+    int after = space - before;
+    return cellRect(index.row()).translated(-horizontalOffset(), -verticalOffset())
+        .adjusted(before, before, -after, -after);
+}
+
+void GridView::scrollTo(const QModelIndex& index, ScrollHint hint) {
+    if (!index.isValid())
+        return;
+
+    QRect rect = cellRect(index.row());
+    bool vertical = itemFlow == QListView::LeftToRight;
+    QScrollBar* bar = vertical ? verticalScrollBar() : horizontalScrollBar();
+    int start = vertical ? rect.top() : rect.left();
+    int end = vertical ? rect.bottom() : rect.right();
+    int extent = vertical ? viewport()->height() : viewport()->width();
+    int offset = bar->value();
+
+    switch (hint) {
+        case PositionAtTop:
+            offset = start;
+            break;
+        case PositionAtBottom:
+            offset = end - extent + 1;
+            break;
+        case PositionAtCenter:
+            offset = (start + end) / 2 - extent / 2;
+            break;
+        case EnsureVisible:
+            if (start < offset)
+                offset = start;
+            else if (end >= offset + extent)
+                offset = end - extent + 1;
+            break;
+    }
+    bar->setValue(offset);
+}
+
+QModelIndex GridView::indexAt(const QPoint& point) const {
+    if (!model())
+        return QModelIndex();
+
+    int row = cellAt(point + QPoint(horizontalOffset(), verticalOffset()));
+    if (row < 0)
+        return QModelIndex();
+
+    QModelIndex index = indexForRow(row);
+    return visualRect(index).contains(point) ? index : QModelIndex();
+}
+
+void GridView::reset() {
+    hoverIndex = QPersistentModelIndex();
+    QAbstractItemView::reset();
+}
+
+void GridView::rowsInserted(const QModelIndex& parent, int start, int end) {
+    QAbstractItemView::rowsInserted(parent, start, end);
+    if (parent == rootIndex()) {
+        updateGeometries();
+        viewport()->update();
+    }
+}
+
+void GridView::rowsAboutToBeRemoved(const QModelIndex& parent, int start, int end) {
+    QAbstractItemView::rowsAboutToBeRemoved(parent, start, end);
+    if (parent == rootIndex())
+        scheduleDelayedItemsLayout();
+}
+
+QModelIndex GridView::moveCursor(CursorAction cursorAction, Qt::KeyboardModifiers) {
+    int count = itemCount();
+    if (count == 0)
+        return QModelIndex();
+
+    QModelIndex current = currentIndex();
+    if (!current.isValid())
+        return indexForRow(0);
+
+    bool leftToRight = itemFlow == QListView::LeftToRight;
+    int length = lineLength();
+    int across = leftToRight ? 1 : length;
+    int down = leftToRight ? length : 1;
+    int linesPerPage = leftToRight ? viewport()->height() / grid.height() : viewport()->width() / grid.width();
+    int page = length * qMax(1, linesPerPage);
+
+    int row = current.row();
+    switch (cursorAction) {
+        case MoveLeft: row -= across; break;
+        case MoveRight: row += across; break;
+        case MoveUp: row -= down; break;
+        case MoveDown: row += down; break;
+        case MovePageUp: row -= page; break;
+        case MovePageDown: row += page; break;
+        case MoveHome: row = 0; break;
+        case MoveEnd: row = count - 1; break;
+        case MovePrevious: row -= 1; break;
+        case MoveNext: row += 1; break;
+    }
+    return indexForRow(qBound(0, row, count - 1));
+}
+
+int GridView::horizontalOffset() const {
+    return horizontalScrollBar()->value();
+}
+
+int GridView::verticalOffset() const {
+    return verticalScrollBar()->value();
+}
+
+bool GridView::isIndexHidden(const QModelIndex&) const {
+    return false;
+}
+
+void GridView::setSelection(const QRect& rect, QItemSelectionModel::SelectionFlags command) {
+    if (!model() || !selectionModel())
+        return;
+
+    QRect area = rect.normalized().translated(horizontalOffset(), verticalOffset());
+    int count = itemCount();
+    int length = lineLength();
+    bool leftToRight = itemFlow == QListView::LeftToRight;
+
+    // Slots are positions along a line, lines run across the scroll direction.
+    int firstSlot, lastSlot, firstLine, lastLine;
+    if (leftToRight) {
+        firstSlot = qMax(0, area.left() / grid.width());
+        lastSlot = qMin(length - 1, area.right() / grid.width());
+        firstLine = qMax(0, area.top() / grid.height());
+        lastLine = area.bottom() / grid.height();
+    } else {
+        firstSlot = qMax(0, area.top() / grid.height());
+        lastSlot = qMin(length - 1, area.bottom() / grid.height());
+        firstLine = qMax(0, area.left() / grid.width());
+        lastLine = area.right() / grid.width();
+    }
+    lastLine = qMin(lastLine, (count - 1) / length);
+
+    QItemSelection selection;
+    if (area.right() >= 0 && area.bottom() >= 0 && firstSlot <= lastSlot) {
+        if (firstSlot == 0 && lastSlot == length - 1) {
+            int first = firstLine * length;
+            int last = qMin(count - 1, lastLine * length + length - 1);
+            if (first <= last)
+                selection.select(indexForRow(first), indexForRow(last));
+        } else {
+            for (int line = firstLine; line <= lastLine; ++line) {
+                int first = line * length + firstSlot;
+                int last = qMin(count - 1, line * length + lastSlot);
+                if (first <= last)
+                    selection.select(indexForRow(first), indexForRow(last));
+            }
+        }
+    }
+    selectionModel()->select(selection, command);
+}
+
+QRegion GridView::visualRegionForSelection(const QItemSelection& selection) const {
+    QRegion region;
+    if (!model())
+        return region;
+
+    int first, last;
+    visibleRange(viewport()->rect().translated(horizontalOffset(), verticalOffset()), &first, &last);
+    for (const QItemSelectionRange& range : selection) {
+        if (range.parent() != rootIndex())
+            continue;
+        for (int row = qMax(range.top(), first); row <= qMin(range.bottom(), last); ++row)
+            region += visualRect(indexForRow(row));
+    }
+    return region;
+}
+
+void GridView::updateGeometries() {
+    int count = itemCount();
+    int length = lineLength();
+    int lines = (count + length - 1) / length;
+
+    if (itemFlow == QListView::LeftToRight) {
+        verticalScrollBar()->setRange(0, qMax(0, lines * grid.height() - viewport()->height()));
+        verticalScrollBar()->setPageStep(viewport()->height());
+        verticalScrollBar()->setSingleStep(grid.height() / 4);
+        horizontalScrollBar()->setRange(0, 0);
+    } else {
+        horizontalScrollBar()->setRange(0, qMax(0, lines * grid.width() - viewport()->width()));
+        horizontalScrollBar()->setPageStep(viewport()->width());
+        horizontalScrollBar()->setSingleStep(grid.width() / 4);
+        verticalScrollBar()->setRange(0, 0);
+    }
+
+    QAbstractItemView::updateGeometries();
+}
+
+void GridView::paintEvent(QPaintEvent* event) {
+    if (!model())
+        return;
+
+    QStyleOptionViewItem option;
+    initViewItemOption(&option);
+    if (mode == QListView::IconMode) {
+        option.decorationPosition = QStyleOptionViewItem::Top;
+        option.displayAlignment = Qt::AlignHCenter | Qt::AlignTop;
+        option.features |= QStyleOptionViewItem::WrapText;
+    } else {
+        option.decorationPosition = QStyleOptionViewItem::Left;
+        option.displayAlignment = Qt::AlignLeft | Qt::AlignVCenter;
+    }
+    QStyle::State baseState = option.state;
+
+    int first, last;
+    visibleRange(event->rect().translated(horizontalOffset(), verticalOffset()), &first, &last);
+
+    QPainter painter(viewport());
+    QModelIndex current = currentIndex();
+    for (int row = first; row <= last; ++row) {
+        QModelIndex index = indexForRow(row);
+        option.rect = visualRect(index);
+        if (!option.rect.intersects(event->rect()))
+            continue;
+
+        option.state = baseState;
+        if (selectionModel() && selectionModel()->isSelected(index))
+            option.state |= QStyle::State_Selected;
+        if (index == current && hasFocus())
+            option.state |= QStyle::State_HasFocus;
+        if (hoverIndex == index)
+            option.state |= QStyle::State_MouseOver;
+        if (!(model()->flags(index) & Qt::ItemIsEnabled))
+            option.state &= ~QStyle::State_Enabled;
+
+        itemDelegateForIndex(index)->paint(&painter, option, index);
+    }
+}
+
+void GridView::resizeEvent(QResizeEvent* event) {
+    QAbstractItemView::resizeEvent(event);
+    viewport()->update();
+}
+
+void GridView::mouseMoveEvent(QMouseEvent* event) {
+    QAbstractItemView::mouseMoveEvent(event);
+
+    QModelIndex index = indexAt(event->position().toPoint());
+    if (hoverIndex == index)
+        return;
+
+    if (hoverIndex.isValid())
+        viewport()->update(visualRect(hoverIndex));
+    hoverIndex = index;
+    if (index.isValid())
+        viewport()->update(visualRect(index));
+}
+
+void GridView::leaveEvent(QEvent* event) {
+    QAbstractItemView::leaveEvent(event);
+
+    if (hoverIndex.isValid())
+        viewport()->update(visualRect(hoverIndex));
+    hoverIndex = QPersistentModelIndex();
+}
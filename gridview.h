@@ -0,0 +1,71 @@
+#ifndef GRIDVIEW_H
+#define GRIDVIEW_H
+
+#include <QAbstractItemView>
+#include <QListView>
+#include <QPersistentModelIndex>
+#include <QSize>
+
+// Item view for the Icons and Tiles modes. Every item occupies one cell of a fixed grid, so positions
+// are computed from the row number alone: painting and hit-testing touch only the visible cells and
+// no per-item layout is ever stored.
+class GridView : public QAbstractItemView {
+    Q_OBJECT
+public:
+    explicit GridView(QWidget* parent = nullptr);
+
+    void setGridSize(const QSize& size);
+    QSize gridSize() const { return grid; }
+
+    void setSpacing(int spacing);
+    int spacing() const { return space; }
+
+    // LeftToRight fills rows and scrolls vertically; TopToBottom fills columns and scrolls horizontally.
+    void setFlow(QListView::Flow flow);
+    QListView::Flow flow() const { return itemFlow; }
+
+    // IconMode puts the decoration above the text, ListMode beside it.
+    void setViewMode(QListView::ViewMode viewMode);
+    QListView::ViewMode viewMode() const { return mode; }
+
+    QRect visualRect(const QModelIndex& index) const override;
+    void scrollTo(const QModelIndex& index, ScrollHint hint = EnsureVisible) override;
+    QModelIndex indexAt(const QPoint& point) const override;
+
+    void reset() override;
+
+protected slots:
+    void rowsInserted(const QModelIndex& parent, int start, int end) override;
+    void rowsAboutToBeRemoved(const QModelIndex& parent, int start, int end) override;
+
+protected:
+    QModelIndex moveCursor(CursorAction cursorAction, Qt::KeyboardModifiers modifiers) override;
+    int horizontalOffset() const override;
+    int verticalOffset() const override;
+    bool isIndexHidden(const QModelIndex& index) const override;
+    void setSelection(const QRect& rect, QItemSelectionModel::SelectionFlags command) override;
+    QRegion visualRegionForSelection(const QItemSelection& selection) const override;
+    void updateGeometries() override;
+
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void leaveEvent(QEvent* event) override;
+
+private:
+    QSize grid;
+    int space;
+    QListView::Flow itemFlow;
+    QListView::ViewMode mode;
+    QPersistentModelIndex hoverIndex;
+
+    int itemCount() const;
+    // Cells along the wrapping direction: columns per row for LeftToRight, rows per column for TopToBottom.
+    int lineLength() const;
+    QRect cellRect(int row) const;
+    int cellAt(const QPoint& contentPoint) const;
+    void visibleRange(const QRect& contentRect, int* first, int* last) const;
+    QModelIndex indexForRow(int row) const;
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include "iconcache.h"
+#include <QFileIconProvider>
+#include <QGuiApplication>
+#include <QLoggingCategory>
+#include <QPixmap>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+
+Q_LOGGING_CATEGORY(lcIcons, "explosion.icons", QtInfoMsg)
+
+namespace {
+
+// List and Details, Tiles, Icons and Content.
+const int ICON_SIZES[] = {16, 32, 48};
+const int NAME_CACHE_ENTRIES = 1024;
+const int FILE_CACHE_ENTRIES = 4096;
+const int DELIVER_INTERVAL_MS = 30;
+const int EXIT_WAIT_MS = 500;
+
+}
+
+struct IconSniff {
+    QString path;
+
+    // Written by the worker before finished is set.
+    QString mimeName;
+    std::atomic<bool> finished{false};
+};
+
+IconCache& IconCache::shared() {
+    // Owned by the application so its pixmaps are released while the GUI still exists.
+    static IconCache* cache = new IconCache(qGuiApp);
+    return *cache;
+}
+
+IconCache::IconCache(QObject* parent)
+    : QObject(parent), mimeLookups(0), pool(new QThreadPool), deliverTimer(new QTimer(this)) {
+    // One reader is plenty for the rows on screen and keeps the disk free for the listing.
+    pool->setMaxThreadCount(1);
+    pool->setThreadPriority(QThread::LowestPriority);
+    deliverTimer->setInterval(DELIVER_INTERVAL_MS);
+    connect(deliverTimer, &QTimer::timeout, this, &IconCache::deliver);
+
+    QFileIconProvider iconProvider;
+    folder = prerendered(iconProvider.icon(QFileIconProvider::Folder));
+    file = prerendered(iconProvider.icon(QFileIconProvider::File));
+    nameIcons.setMaxCost(NAME_CACHE_ENTRIES);
+    fileIcons.setMaxCost(FILE_CACHE_ENTRIES);
+}
+
+IconCache::~IconCache() {
+    pool->clear();
+    // A read stuck on a hung disk cannot be interrupted; leaking the pool lets the application exit
+    // anyway. Workers only touch their sniff, which they co-own.
+    if (pool->waitForDone(EXIT_WAIT_MS))
+        delete pool;
+}
+
+QIcon IconCache::iconForName(const QString& name) {
+    // Same notion of a suffix as the Type column: a leading or trailing dot does not start one.
+    qsizetype dot = name.lastIndexOf(QLatin1Char('.'));
+    if (dot > 0 && dot < name.size() - 1) {
+        QString suffix = name.mid(dot + 1).toLower();
+        auto it = suffixIcons.constFind(suffix);
+        if (it != suffixIcons.constEnd())
+            return *it;
+
+        QIcon icon = iconForNameMatch(QLatin1String("file.") + suffix, true);
+        suffixIcons.insert(suffix, icon);
+        return icon;
+    }
+
+    // Names without a suffix can still match a pattern of their own (Makefile, README); the few common
+    // ones repeat across folders.
+    if (QIcon* icon = nameIcons.object(name))
+        return *icon;
+    QIcon icon = iconForNameMatch(name, false);
+    nameIcons.insert(name, new QIcon(icon));
+    return icon;
+}
+
+QIcon IconCache::iconForFile(const QString& path) {
+    if (QIcon* icon = fileIcons.object(path))
+        return *icon;
+
+    // Reading the content can block on the disk, so it never happens while painting.
+    if (!sniffing.contains(path)) {
+        sniffing.insert(path);
+        auto sniff = std::make_shared<IconSniff>();
+        sniff->path = path;
+        sniffs.push_back(sniff);
+        pool->start([sniff]() {
+            QMimeDatabase database;
+            sniff->mimeName = database.mimeTypeForFile(sniff->path).name();
+            sniff->finished.store(true, std::memory_order_release);
+        });
+        if (!deliverTimer->isActive())
+            deliverTimer->start();
+    }
+    return file;
+}
+
+void IconCache::deliver() {
+    bool changed = false;
+    for (auto it = sniffs.begin(); it != sniffs.end();) {
+        const std::shared_ptr<IconSniff>& sniff = *it;
+        if (!sniff->finished.load(std::memory_order_acquire)) {
+            ++it;
+            continue;
+        }
+
+        ++mimeLookups;
+        qCDebug(lcIcons) << "Sniffed" << sniff->path << "as" << sniff->mimeName << "lookups" << mimeLookups;
+        QIcon icon = iconForMimeType(mimeDatabase.mimeTypeForName(sniff->mimeName));
+        fileIcons.insert(sniff->path, new QIcon(icon));
+        sniffing.remove(sniff->path);
+        it = sniffs.erase(it);
+        changed = true;
+    }
+
+    if (sniffs.empty())
+        deliverTimer->stop();
+    if (changed)
+        emit fileIconsChanged();
+}
+
+QIcon IconCache::iconForNameMatch(const QString& fileName, bool hasSuffix) {
+    ++mimeLookups;
+    const QList<QMimeType> mimeTypes = mimeDatabase.mimeTypesForFileName(fileName);
+    qCDebug(lcIcons) << "Resolved" << fileName << "to" << mimeTypes.size() << "types, lookups" << mimeLookups;
+
+    if (mimeTypes.size() == 1)
+        return iconForMimeType(mimeTypes.first());
+    // An unknown suffix says nothing worth reading the file for.
+    if (mimeTypes.isEmpty() && hasSuffix)
+        return file;
+    return QIcon();
+}
+
+QIcon IconCache::iconForMimeType(const QMimeType& mimeType) {
+    auto it = mimeIcons.constFind(mimeType.name());
+    if (it != mimeIcons.constEnd())
+        return *it;
+
+    QIcon source = QIcon::fromTheme(mimeType.iconName());
+    if (source.isNull())
+        source = QIcon::fromTheme(mimeType.genericIconName());
+    QIcon icon = source.isNull() ? file : prerendered(source);
+    mimeIcons.insert(mimeType.name(), icon);
+    return icon;
+}
+
+QIcon IconCache::prerendered(const QIcon& source) {
+    qreal ratio = qGuiApp->devicePixelRatio();
+    QIcon icon;
+    for (int size : ICON_SIZES)
+        icon.addPixmap(source.pixmap(QSize(size, size), ratio));
+    return icon;
+}
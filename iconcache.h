@@ -0,0 +1,64 @@
+#ifndef ICONCACHE_H
+#define ICONCACHE_H
+
+#include <QCache>
+#include <QHash>
+#include <QIcon>
+#include <QMimeDatabase>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <memory>
+#include <vector>
+
+class QThreadPool;
+class QTimer;
+struct IconSniff;
+
+// File type icons shared by the listing and result models, GUI thread only. A type is resolved once per
+// suffix; the MIME database is asked again only for names whose suffix maps to several types, or that have
+// none, and then the file's content decides, read on a background thread. Icons come pre-rendered at the
+// sizes the views draw, so painting never goes back to the icon theme.
+class IconCache : public QObject {
+    Q_OBJECT
+public:
+    static IconCache& shared();
+
+    QIcon folderIcon() const { return folder; }
+    QIcon fileIcon() const { return file; }
+
+    // The icon of a file's type when its name settles it, or a null icon when the content has to.
+    QIcon iconForName(const QString& name);
+
+    // The icon of the file's sniffed content, kept per path. Until the sniff finishes this is the generic
+    // file icon, and fileIconsChanged() follows once it has.
+    QIcon iconForFile(const QString& path);
+
+signals:
+    void fileIconsChanged();
+
+private:
+    explicit IconCache(QObject* parent);
+    ~IconCache();
+
+    QMimeDatabase mimeDatabase;
+    QIcon folder;
+    QIcon file;
+    QHash<QString, QIcon> suffixIcons;
+    QHash<QString, QIcon> mimeIcons;
+    QCache<QString, QIcon> nameIcons;
+    QCache<QString, QIcon> fileIcons;
+    qint64 mimeLookups;
+    QThreadPool* pool;
+    QTimer* deliverTimer;
+    QSet<QString> sniffing;
+    std::vector<std::shared_ptr<IconSniff>> sniffs;
+
+    void deliver();
+
+    QIcon iconForNameMatch(const QString& fileName, bool hasSuffix);
+    QIcon iconForMimeType(const QMimeType& mimeType);
+    static QIcon prerendered(const QIcon& source);
+};
+
+#endif
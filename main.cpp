@@ -21,10 +21,16 @@
 #include <QUrl>
 #include <QLineEdit>
 #include <QStackedWidget>
+#include <QLocale>
+#include <QTimer>
 
 #include "ribbonbar.h"
 #include "fileviewmodel.h"
 #include "searchmanager.h"
+#include "searchresultsmodel.h"
+#include "duplicatefinder.h"
+#include "duplicatesmodel.h"
+#include "mounttable.h"
 #include "tabs/filetab.h"
 #include "tabs/hometab.h"
 #include "tabs/sharetab.h"
@@ -42,6 +48,8 @@ public:
         fileViewModel->setupFileSystem(viewContainer);
         
         searchManager = new SearchManager(this);
+        duplicateFinder = new DuplicateFinder(this);
+        duplicatesModel = new DuplicatesModel(this);
         
         connect(searchManager, &SearchManager::searchFilterChanged, 
                 this, &Explosion::onSearchFilterChanged);
@@ -52,20 +60,41 @@ public:
         connect(searchManager, &SearchManager::searchCleared,
                 this, &Explosion::onSearchCleared);
         
+        connect(duplicateFinder, &DuplicateFinder::progress, this, [this](const QString& message) {
+            statusBar()->showMessage(message);
+        });
+        connect(duplicateFinder, &DuplicateFinder::finished, this, &Explosion::onDuplicatesFound);
+        connect(ribbon, &RibbonBar::findDuplicatesRequested, this, &Explosion::findDuplicates);
+        
         connect(fileViewModel, &FileViewModel::itemActivated, 
                 this, &Explosion::onItemActivated);
         
+        prefetchTimer = new QTimer(this);
+        prefetchTimer->setSingleShot(true);
+        prefetchTimer->setInterval(PREFETCH_IDLE_MS);
+        connect(prefetchTimer, &QTimer::timeout, this, &Explosion::prefetchLikelyFolders);
+        connect(fileViewModel, &FileViewModel::directoryLoaded, this, [this]() { prefetchTimer->start(); });
+        connect(fileViewModel, &FileViewModel::directoryHovered, this, [this](const QString& path) {
+            hoveredFolder = path;
+            prefetchTimer->start();
+        });
+        
         connect(ribbon, &RibbonBar::recentFolderNavigated, this, &Explosion::onRecentFolderSelected);
         
         connect(ribbon, &RibbonBar::addressBarNavigated, this, &Explosion::addressBarNavigateRequested);
         connect(ribbon, &RibbonBar::searchRequested, this, &Explosion::performSearch);
+        connect(ribbon, &RibbonBar::searchTextEdited, searchManager, &SearchManager::incrementalSearch);
         connect(ribbon, &RibbonBar::viewModeChanged, this, &Explosion::onViewModeChanged);
+        connect(ribbon, &RibbonBar::folderSizesToggled, fileViewModel, &FileViewModel::setFolderSizesEnabled);
         
         currentPath = QDir::homePath();
         navigateToPath(currentPath);
     }
 
 private:
+    static const int PREFETCH_IDLE_MS = 400;
+    static const int PREFETCH_SUBFOLDER_LIMIT = 32;
+    
     QTreeView* navigationTree;
     QStackedWidget* viewContainer;  
     QStandardItemModel* quickAccessModel;
@@ -78,6 +107,10 @@ private:
     
     FileViewModel* fileViewModel;
     SearchManager* searchManager;
+    DuplicateFinder* duplicateFinder;
+    DuplicatesModel* duplicatesModel;
+    QTimer* prefetchTimer;
+    QString hoveredFolder;
     
     void setupUI() {
         QWidget* centralWidget = new QWidget(this);
@@ -213,13 +246,18 @@ private:
     
 
     void navigateToPath(const QString& path, bool addToHistory = true) {
-        if (!QFileInfo::exists(path)) return;
+        // On a network or FUSE mount even this check can hang; the listing reports a missing folder instead.
+        bool slowPath = MountTable::isSlowPath(path);
+        if (!slowPath && !QFileInfo::exists(path)) return;
         
         if (addToHistory && !currentPath.isEmpty()) {
             backStack.push(currentPath);
             forwardStack.clear();
         }
         
+        prefetchTimer->stop();
+        hoveredFolder.clear();
+        
         currentPath = path;
         fileViewModel->setRootPath(path);
         searchManager->setBaseDirectory(path);
@@ -228,6 +266,9 @@ private:
             searchManager->clearSearch();
         }
         
+        duplicateFinder->cancel();
+        fileViewModel->showDirectoryListing();
+        
         ribbon->updateRecentFolders(path);
         
         statusBar()->showMessage("Location: " + path);
@@ -237,7 +278,7 @@ private:
         if (navToolBar) {
             navToolBar->actions()[0]->setEnabled(!backStack.isEmpty());
             navToolBar->actions()[1]->setEnabled(!forwardStack.isEmpty());
-            navToolBar->actions()[3]->setEnabled(QDir(path).cdUp());
+            navToolBar->actions()[3]->setEnabled(slowPath ? QDir::cleanPath(path) != "/" : QDir(path).cdUp());
         }
     }
 
@@ -256,6 +297,14 @@ private:
     }
 
     void navigateUp() {
+        // cdUp() stats the parent, which on a hung mount would freeze the window.
+        if (MountTable::isSlowPath(currentPath)) {
+            QString parent = QDir::cleanPath(currentPath + "/..");
+            if (parent != QDir::cleanPath(currentPath))
+                navigateToPath(parent);
+            return;
+        }
+        
         QDir currentDir(currentPath);
         if (currentDir.cdUp()) {
             navigateToPath(currentDir.absolutePath());
@@ -266,6 +315,21 @@ private:
         QDesktopServices::openUrl(QUrl::fromLocalFile(filePath));
     }
 
+    // Most likely next stop first: what the pointer rests on, then Back, then recent folders, then children.
+    void prefetchLikelyFolders() {
+        QStringList candidates;
+        if (!hoveredFolder.isEmpty())
+            candidates << hoveredFolder;
+        if (!backStack.isEmpty())
+            candidates << backStack.top();
+        candidates << ribbon->recentFolderPaths();
+        candidates << fileViewModel->subfolderPaths(PREFETCH_SUBFOLDER_LIMIT);
+        
+        candidates.removeAll(currentPath);
+        candidates.removeDuplicates();
+        fileViewModel->prefetchDirectories(candidates);
+    }
+
 private slots:
     void addressBarNavigateRequested(const QString& path) {
         navigateToPath(path);
@@ -276,23 +340,45 @@ private slots:
     }
 
     void performSearch(const QString& searchText) {
+        duplicateFinder->cancel();
         searchManager->quickSearch(searchText);
     }
     
+    void findDuplicates() {
+        if (searchManager->isSearchActive())
+            searchManager->clearSearch();
+        duplicatesModel->clear();
+        duplicateFinder->start(currentPath);
+    }
+    
+    void onDuplicatesFound(const QVector<DuplicateGroup>& groups) {
+        duplicatesModel->setGroups(groups);
+        fileViewModel->showSearchResults(duplicatesModel);
+        statusBar()->showMessage(QString("%1 duplicate sets in %2, %3 reclaimable")
+            .arg(duplicatesModel->groupCount())
+            .arg(currentPath)
+            .arg(QLocale::system().formattedDataSize(duplicatesModel->reclaimableBytes())));
+    }
+    
     void onSearchFilterChanged(const QStringList& filters, bool hideNonMatching) {
         fileViewModel->applySearchFilter(filters, hideNonMatching);
         updateAddressBar(currentPath);
     }
     
     void onSearchStarted() {
+        if (searchManager->criteria().includeSubdirectories) {
+            fileViewModel->showSearchResults(searchManager->resultsModel());
+        }
+        updateAddressBar(currentPath);
         statusBar()->showMessage("Searching...");
     }
     
     void onSearchFinished(int resultCount) {
         if (resultCount >= 0) {
-            statusBar()->showMessage(QString("Found %1 results for \"%2\"")
+            statusBar()->showMessage(QString("Found %1 results for \"%2\"%3")
                 .arg(resultCount)
-                .arg(searchManager->lastQuery()));
+                .arg(searchManager->lastQuery())
+                .arg(searchManager->lastSearchUsedIndex() ? " (indexed)" : ""));
         } else {
             statusBar()->showMessage(QString("Searching for \"%1\" in %2")
                 .arg(searchManager->lastQuery())
@@ -301,6 +387,7 @@ private slots:
     }
     
     void onSearchCleared() {
+        fileViewModel->showDirectoryListing();
         statusBar()->showMessage("Search cleared");
     }
     
@@ -312,8 +399,7 @@ private slots:
         QString path = index.data(Qt::UserRole + 1).toString();
 
         if (!path.isEmpty()) {
-            QFileInfo fileInfo(path);
-            if (fileInfo.exists() && fileInfo.isDir()) {
+            if (MountTable::isSlowPath(path) || QFileInfo(path).isDir()) {
                 navigateToPath(path);
             }
         }
@@ -322,11 +408,11 @@ private slots:
     void onItemActivated(const QModelIndex& index) {
         if (!index.isValid()) return;
 
-        QFileInfo fileInfo = fileViewModel->model()->fileInfo(index);
-        if (fileInfo.isDir()) {
-            navigateToPath(fileInfo.absoluteFilePath());
+        QString path = QDir::cleanPath(index.data(QFileSystemModel::FilePathRole).toString());
+        if (fileViewModel->isDirectory(index)) {
+            navigateToPath(path);
         } else {
-            openFile(fileInfo.absoluteFilePath());
+            openFile(path);
         }
     }
 
@@ -0,0 +1,222 @@
+#include "metadataloader.h"
+#include "statxbatch.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSettings>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const int BATCH_SIZE = 64;
+const int MAX_THREADS = 8;
+const int DELIVER_INTERVAL_MS = 30;
+const int DEFAULT_SLOW_CONCURRENCY = 2;
+const int DEFAULT_TIMEOUT_MS = 5000;
+const int EXIT_WAIT_MS = 500;
+
+}
+
+struct MetadataBatch {
+    quint64 generation = 0;
+    int mountId = -1;
+    int limit = 1;
+    QByteArray directory;
+    unsigned int mask = 0;
+    std::vector<quint32> entries;
+    QByteArray names;
+    QElapsedTimer requested;
+
+    // Written by the worker; results[0, resolved) are complete.
+    std::vector<MetadataResult> results;
+    std::atomic<int> resolved{0};
+    std::atomic<bool> finished{false};
+    std::atomic<bool> cancelled{false};
+
+    // GUI thread only.
+    int delivered = 0;
+    bool timedOut = false;
+};
+
+namespace {
+
+void resolveBatch(MetadataBatch& batch) {
+    size_t count = batch.entries.size();
+    std::vector<const char*> names(count);
+    const char* name = batch.names.constData();
+    for (size_t i = 0; i < count; ++i) {
+        names[i] = name;
+        name += std::strlen(name) + 1;
+    }
+
+    std::vector<struct statx> stats(count);
+    std::vector<int> errors(count, ENOENT);
+    int fd = -1;
+    if (!batch.cancelled.load())
+        fd = ::open(batch.directory.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        statxBatch(fd, names.data(), count, batch.mask, stats.data(), errors.data(), StatxIoUring);
+        ::close(fd);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        MetadataResult& result = batch.results[i];
+        result = {batch.entries[i], MetadataResult::Failed, 0, 0, 0};
+        if (errors[i] == 0) {
+            const struct statx& stx = stats[i];
+            result.status = MetadataResult::Resolved;
+            result.mode = stx.stx_mode;
+            result.size = qint64(stx.stx_size);
+            result.modifiedMsecs = qint64(stx.stx_mtime.tv_sec) * 1000 + stx.stx_mtime.tv_nsec / 1000000;
+        }
+    }
+    batch.resolved.store(int(count), std::memory_order_release);
+    batch.finished.store(true, std::memory_order_release);
+}
+
+}
+
+MetadataLoader::MetadataLoader(QObject* parent)
+    : QObject(parent), pool(new QThreadPool), dispatchTimer(new QTimer(this)), deliverTimer(new QTimer(this)),
+      mountId(-1), mountLimit(MAX_THREADS), timeoutMs(DEFAULT_TIMEOUT_MS), generation(0) {
+    pool->setMaxThreadCount(MAX_THREADS);
+
+    // Requests made while one paint pass runs are collected into as few batches as possible.
+    dispatchTimer->setSingleShot(true);
+    dispatchTimer->setInterval(0);
+    connect(dispatchTimer, &QTimer::timeout, this, [this]() {
+        queueFilling();
+        dispatch();
+    });
+
+    deliverTimer->setInterval(DELIVER_INTERVAL_MS);
+    connect(deliverTimer, &QTimer::timeout, this, &MetadataLoader::deliver);
+}
+
+MetadataLoader::~MetadataLoader() {
+    for (const std::shared_ptr<MetadataBatch>& batch : running)
+        batch->cancelled = true;
+
+    // A thread stuck in a stat on a hung mount cannot be interrupted; leaking the pool lets the window
+    // close anyway. Workers only touch their batch, which they co-own.
+    if (pool->waitForDone(EXIT_WAIT_MS))
+        delete pool;
+}
+
+void MetadataLoader::setDirectory(const QString& path, const MountInfo& mount) {
+    reset();
+
+    QSettings settings("Explosion", "Explosion");
+    directory = QFile::encodeName(path);
+    mountId = mount.id;
+    mountLimit = mount.slow ? qMax(1, settings.value("filesystem/slowConcurrency", DEFAULT_SLOW_CONCURRENCY).toInt())
+                            : MAX_THREADS;
+    timeoutMs = settings.value("filesystem/slowTimeoutMs", DEFAULT_TIMEOUT_MS).toInt();
+}
+
+void MetadataLoader::reset() {
+    ++generation;
+    for (const std::shared_ptr<MetadataBatch>& batch : running)
+        batch->cancelled = true;
+    filling.reset();
+    waiting.clear();
+}
+
+void MetadataLoader::request(quint32 entry, const char* name, unsigned int mask) {
+    if (filling && filling->mask != mask)
+        queueFilling();
+    if (!filling) {
+        filling = std::make_shared<MetadataBatch>();
+        filling->generation = generation;
+        filling->mountId = mountId;
+        filling->limit = mountLimit;
+        filling->directory = directory;
+        filling->mask = mask;
+        filling->requested.start();
+    }
+
+    filling->entries.push_back(entry);
+    filling->names.append(name, qsizetype(std::strlen(name)) + 1);
+    if (int(filling->entries.size()) >= BATCH_SIZE)
+        queueFilling();
+    dispatchTimer->start();
+}
+
+void MetadataLoader::queueFilling() {
+    if (!filling)
+        return;
+
+    waiting.push_back(std::move(filling));
+    filling.reset();
+}
+
+void MetadataLoader::dispatch() {
+    while (!waiting.empty()) {
+        std::shared_ptr<MetadataBatch> batch = waiting.front();
+        if (batch->generation != generation) {
+            waiting.pop_front();
+            continue;
+        }
+
+        // Batches of earlier folders still stuck on this mount count against its limit too.
+        int& active = activeBatches[batch->mountId];
+        if (active >= batch->limit)
+            break;
+
+        waiting.pop_front();
+        ++active;
+        batch->results.resize(batch->entries.size());
+        running.push_back(batch);
+        pool->start([batch]() { resolveBatch(*batch); });
+    }
+
+    if (!running.empty() || !waiting.empty())
+        deliverTimer->start();
+}
+
+void MetadataLoader::deliver() {
+    QVector<MetadataResult> results;
+
+    for (auto it = running.begin(); it != running.end();) {
+        MetadataBatch& batch = **it;
+        bool finished = batch.finished.load(std::memory_order_acquire);
+        int resolved = batch.resolved.load(std::memory_order_acquire);
+        if (batch.generation == generation) {
+            for (int i = batch.delivered; i < resolved; ++i)
+                results.append(batch.results[size_t(i)]);
+        }
+        batch.delivered = resolved;
+
+        if (finished) {
+            --activeBatches[batch.mountId];
+            it = running.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    auto expire = [&](MetadataBatch& batch) {
+        if (batch.timedOut || batch.generation != generation || batch.requested.elapsed() < timeoutMs)
+            return;
+        batch.timedOut = true;
+        for (size_t i = size_t(batch.delivered); i < batch.entries.size(); ++i)
+            results.append({batch.entries[i], MetadataResult::TimedOut, 0, 0, 0});
+    };
+    for (const std::shared_ptr<MetadataBatch>& batch : running)
+        expire(*batch);
+    for (const std::shared_ptr<MetadataBatch>& batch : waiting)
+        expire(*batch);
+
+    if (!results.isEmpty())
+        emit resultsReady(results);
+
+    dispatch();
+    if (running.empty() && waiting.empty())
+        deliverTimer->stop();
+}
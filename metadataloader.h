@@ -0,0 +1,74 @@
+#ifndef METADATALOADER_H
+#define METADATALOADER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "mounttable.h"
+
+class QThreadPool;
+class QTimer;
+struct MetadataBatch;
+
+struct MetadataResult {
+    enum Status : quint8 {
+        Resolved,
+        Failed,
+        TimedOut
+    };
+
+    quint32 entry;
+    Status status;
+    quint32 mode;
+    qint64 size;
+    qint64 modifiedMsecs;
+};
+
+// Stats directory entries off the GUI thread. Requests are grouped into batches that each go to the kernel
+// through one io_uring, at most a per-mount number of batches run at once, and entries still unresolved when
+// the timeout passes are reported as TimedOut; a late answer is still delivered and replaces that.
+class MetadataLoader : public QObject {
+    Q_OBJECT
+public:
+    explicit MetadataLoader(QObject* parent = nullptr);
+    ~MetadataLoader();
+
+    void setDirectory(const QString& path, const MountInfo& mount);
+
+    // Drops every outstanding request; results still on their way are ignored.
+    void reset();
+
+    // mask is the statx() field mask; asking for fewer fields lets network file systems skip revalidation.
+    void request(quint32 entry, const char* name, unsigned int mask);
+
+signals:
+    void resultsReady(const QVector<MetadataResult>& results);
+
+private:
+    QThreadPool* pool;
+    QTimer* dispatchTimer;
+    QTimer* deliverTimer;
+
+    QByteArray directory;
+    int mountId;
+    int mountLimit;
+    int timeoutMs;
+    quint64 generation;
+
+    std::shared_ptr<MetadataBatch> filling;
+    std::deque<std::shared_ptr<MetadataBatch>> waiting;
+    std::vector<std::shared_ptr<MetadataBatch>> running;
+    QHash<int, int> activeBatches;
+
+    void queueFilling();
+    void dispatch();
+    void deliver();
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "mounttable.h"
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QStringList>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+namespace {
+
+const char* const SLOW_FS_TYPES[] = {
+    "nfs", "nfs4", "cifs", "smb3", "smbfs", "9p", "afs", "ceph", "glusterfs", "lustre", "gpfs", "davfs", "sshfs",
+};
+
+// Mount points escape space, tab, newline and backslash as three octal digits.
+QString unescapeMountPath(const QByteArray& field) {
+    QByteArray path;
+    path.reserve(field.size());
+    for (qsizetype i = 0; i < field.size(); ++i) {
+        if (field[i] == '\\' && i + 3 < field.size() && field[i + 1] >= '0' && field[i + 1] <= '3') {
+            path.append(char(((field[i + 1] - '0') << 6) | ((field[i + 2] - '0') << 3) | (field[i + 3] - '0')));
+            i += 3;
+        } else {
+            path.append(field[i]);
+        }
+    }
+    return QFile::decodeName(path);
+}
+
+bool isSlowType(const QString& type, const QStringList& extraTypes) {
+    // fuseblk is ntfs-3g and friends on local disks; every other FUSE mount may be remote.
+    if (type.startsWith(QLatin1String("fuse.")) || type == QLatin1String("fuse"))
+        return true;
+    for (const char* slowType : SLOW_FS_TYPES) {
+        if (type == QLatin1String(slowType))
+            return true;
+    }
+    return extraTypes.contains(type);
+}
+
+}
+
+MountTable MountTable::read() {
+    static QMutex mutex;
+    static int fd = -1;
+    static bool loaded = false;
+    static QString mode;
+    static QStringList extraTypes;
+    static MountTable table;
+
+    QMutexLocker locker(&mutex);
+    if (!loaded) {
+        QSettings settings("Explosion", "Explosion");
+        mode = settings.value("filesystem/slowMode", "auto").toString();
+        extraTypes = settings.value("filesystem/slowTypes").toStringList();
+        fd = ::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+    } else {
+        // The kernel flags an open mountinfo with POLLPRI once after each mount or unmount.
+        struct pollfd changed = {fd, POLLPRI, 0};
+        if (fd < 0 || ::poll(&changed, 1, 0) <= 0 || !(changed.revents & (POLLPRI | POLLERR)))
+            return table;
+    }
+    loaded = true;
+    if (fd < 0)
+        return table;
+
+    QByteArray contents;
+    char buffer[16384];
+    ssize_t got;
+    ::lseek(fd, 0, SEEK_SET);
+    while ((got = ::read(fd, buffer, sizeof(buffer))) > 0)
+        contents.append(buffer, qsizetype(got));
+    table = parse(contents, mode, extraTypes);
+    return table;
+}
+
+MountTable MountTable::parse(const QByteArray& mountInfo, const QString& mode, const QStringList& extraTypes) {
+    MountTable table;
+
+    // id parent major:minor root mount-point options [optional fields...] - type source super-options
+    const QList<QByteArray> lines = mountInfo.split('\n');
+    for (const QByteArray& line : lines) {
+        QList<QByteArray> fields = line.split(' ');
+        qsizetype separator = fields.indexOf(QByteArrayLiteral("-"));
+        if (fields.size() < 5 || separator < 0 || separator + 1 >= fields.size())
+            continue;
+
+        MountInfo mount;
+        mount.id = fields[0].toInt();
+        QList<QByteArray> numbers = fields[2].split(':');
+        mount.device = numbers.size() == 2 ? quint64(makedev(numbers[0].toUInt(), numbers[1].toUInt())) : 0;
+        mount.mountPoint = unescapeMountPath(fields[4]);
+        mount.fsType = QString::fromLatin1(fields[separator + 1]);
+        if (mode == QLatin1String("always"))
+            mount.slow = true;
+        else if (mode == QLatin1String("never"))
+            mount.slow = false;
+        else
+            mount.slow = isSlowType(mount.fsType, extraTypes);
+        table.mounts.append(mount);
+    }
+    return table;
+}
+
+MountInfo MountTable::mountFor(const QString& path) const {
+    QString cleaned = QDir::cleanPath(path);
+    const MountInfo* best = nullptr;
+
+    // Later entries are stacked on top of earlier ones at the same mount point, hence >=.
+    for (const MountInfo& mount : mounts) {
+        const QString& point = mount.mountPoint;
+        bool contains = point == QLatin1String("/") || cleaned == point ||
+                        (cleaned.startsWith(point) && cleaned.at(point.size()) == QLatin1Char('/'));
+        if (contains && (!best || point.size() >= best->mountPoint.size()))
+            best = &mount;
+    }
+
+    if (best)
+        return *best;
+    return MountInfo{-1, 0, QStringLiteral("/"), QString(), false};
+}
+
+MountInfo MountTable::mountForDevice(quint64 device) const {
+    for (qsizetype i = mounts.size() - 1; i >= 0; --i) {
+        if (mounts[i].device == device)
+            return mounts[i];
+    }
+    return MountInfo{-1, device, QString(), QString(), false};
+}
@@ -0,0 +1,39 @@
+#ifndef MOUNTTABLE_H
+#define MOUNTTABLE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+struct MountInfo {
+    int id;
+    quint64 device;
+    QString mountPoint;
+    QString fsType;
+    // Network and FUSE filesystems, where a single stat can stall for seconds.
+    bool slow;
+};
+
+// Snapshot of /proc/self/mountinfo. Reading it is served by the kernel's mount table and never
+// touches the mounted filesystems, so it is safe on the GUI thread even when a mount hangs.
+class MountTable {
+public:
+    // The current table. It is parsed once and again only after the kernel reports a mount change, so
+    // this is cheap enough for every navigation; the settings are read the first time. Thread-safe.
+    static MountTable read();
+
+    MountInfo mountFor(const QString& path) const;
+
+    // The mount whose st_dev is device; the topmost one when it is mounted more than once.
+    MountInfo mountForDevice(quint64 device) const;
+
+    static bool isSlowPath(const QString& path) { return read().mountFor(path).slow; }
+
+private:
+    QVector<MountInfo> mounts;
+
+    static MountTable parse(const QByteArray& mountInfo, const QString& mode, const QStringList& extraTypes);
+};
+
+#endif
@@ -34,6 +34,8 @@ RibbonBar::RibbonBar(QWidget *parent) : QWidget(parent)
     tabWidget->addTab(viewTab, "View");
     
     connect(viewTab, &ViewTab::viewModeChanged, this, &RibbonBar::viewModeChanged);
+    connect(viewTab, &ViewTab::folderSizesToggled, this, &RibbonBar::folderSizesToggled);
+    connect(homeTab, &HomeTab::findDuplicatesRequested, this, &RibbonBar::findDuplicatesRequested);
 
     QToolBar *toolbar = new QToolBar("Navigation");
     toolbar->setMovable(false);
@@ -151,6 +153,7 @@ RibbonBar::RibbonBar(QWidget *parent) : QWidget(parent)
 
     connect(addressBar, &QLineEdit::returnPressed, this, &RibbonBar::onAddressBarEntered);
     connect(searchBar, &QLineEdit::returnPressed, this, &RibbonBar::onSearchBarEntered);
+    connect(searchBar, &QLineEdit::textEdited, this, &RibbonBar::searchTextEdited);
 
     mainLayout->addWidget(tabWidget);
     mainLayout->addWidget(toolbar);
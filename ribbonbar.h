@@ -23,6 +23,7 @@ public:
     QLineEdit* getAddressBar() const { return addressBar; }
     QLineEdit* getSearchBar() const { return searchBar; }
     void updateRecentFolders(const QString& path);
+    QStringList recentFolderPaths() const { return recentFolders; }
 
 private:
     QTabWidget *tabWidget;
@@ -40,8 +41,11 @@ private:
 signals:
     void addressBarNavigated(const QString& path);
     void searchRequested(const QString& searchText);
+    void searchTextEdited(const QString& searchText);
     void recentFolderNavigated(const QString& path);
     void viewModeChanged(ViewMode mode);
+    void folderSizesToggled(bool enabled);
+    void findDuplicatesRequested();
 
 private slots:
     void onAddressBarEntered();
@@ -0,0 +1,129 @@
+#include "rowtextcache.h"
+#include <QAbstractItemModel>
+#include <QLoggingCategory>
+#include <QPainter>
+#include <QRect>
+#include <QTransform>
+#include <utility>
+#include <vector>
+
+Q_LOGGING_CATEGORY(lcPaint, "explosion.paint", QtInfoMsg)
+
+namespace {
+
+// A few screens of rows; scrolling further lays rows out again.
+const int MAX_ROWS = 2048;
+const int REPORT_INTERVAL = 1000;
+
+}
+
+RowTextCache::RowTextCache(const char* delegateName, int detailColumn, QObject* parent)
+    : QObject(parent), delegateName(delegateName), detailColumn(detailColumn), paints(0), paintNsecs(0), hits(0),
+      misses(0) {
+    rows.setMaxCost(MAX_ROWS);
+}
+
+const RowTextCache::Row* RowTextCache::find(const QModelIndex& index, int width, const QFont& rowFont) {
+    if (index.model() != model)
+        track(index.model());
+    if (rowFont != font) {
+        rows.clear();
+        font = rowFont;
+    }
+
+    const Row* row = rows.object(index.row());
+    if (row && row->width == width) {
+        ++hits;
+        return row;
+    }
+    ++misses;
+    return nullptr;
+}
+
+const RowTextCache::Row* RowTextCache::insert(const QModelIndex& index, const Row& row) {
+    rows.insert(index.row(), new Row(row));
+    return rows.object(index.row());
+}
+
+QStaticText RowTextCache::layout(const QString& text, const QFont& font) {
+    QStaticText staticText(text);
+    staticText.setTextFormat(Qt::PlainText);
+    staticText.setPerformanceHint(QStaticText::AggressiveCaching);
+    staticText.prepare(QTransform(), font);
+    return staticText;
+}
+
+void RowTextCache::draw(QPainter* painter, const QRect& rect, const QStaticText& text, Qt::Alignment alignment) {
+    QSizeF size = text.size();
+    qreal x = (alignment & Qt::AlignRight) ? rect.right() + 1 - size.width() : rect.left();
+    painter->drawStaticText(QPointF(x, rect.top() + (rect.height() - size.height()) / 2), text);
+}
+
+void RowTextCache::recordPaint(qint64 nsecs) {
+    paintNsecs += nsecs;
+    if (++paints < REPORT_INTERVAL)
+        return;
+
+    qCDebug(lcPaint) << delegateName << "delegate:" << paintNsecs / paints / 1000.0 << "us per paint over" << paints
+                     << "paints, layout hits" << hits << "misses" << misses;
+    paints = 0;
+    paintNsecs = 0;
+}
+
+void RowTextCache::track(const QAbstractItemModel* newModel) {
+    if (model)
+        disconnect(model, nullptr, this, nullptr);
+    rows.clear();
+    model = newModel;
+    if (!newModel)
+        return;
+
+    // A reset or new layout makes the row numbers meaningless. Inserts and removes, which a streamed listing
+    // or a filter being typed produce in bursts, only renumber the rows after them.
+    auto clear = [this]() { rows.clear(); };
+    connect(newModel, &QAbstractItemModel::modelReset, this, clear);
+    connect(newModel, &QAbstractItemModel::layoutChanged, this, clear);
+    connect(newModel, &QAbstractItemModel::rowsMoved, this, clear);
+    connect(newModel, &QAbstractItemModel::rowsInserted, this,
+            [this](const QModelIndex& parent, int first, int last) {
+        if (!parent.isValid())
+            shiftRows(first, first - 1, last - first + 1);
+    });
+    connect(newModel, &QAbstractItemModel::rowsRemoved, this,
+            [this](const QModelIndex& parent, int first, int last) {
+        if (!parent.isValid())
+            shiftRows(first, last, -(last - first + 1));
+    });
+    connect(newModel, &QAbstractItemModel::dataChanged, this, &RowTextCache::rowsChanged);
+}
+
+// Drops the cached rows first to last and renumbers the ones after them by delta.
+void RowTextCache::shiftRows(int first, int last, int delta) {
+    std::vector<std::pair<int, Row*>> moved;
+    const QList<int> cached = rows.keys();
+    for (int row : cached) {
+        if (row < first)
+            continue;
+        Row* taken = rows.take(row);
+        if (row > last)
+            moved.emplace_back(row + delta, taken);
+        else
+            delete taken;
+    }
+    for (const std::pair<int, Row*>& row : moved)
+        rows.insert(row.first, row.second);
+}
+
+void RowTextCache::rowsChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight) {
+    bool shownColumn = topLeft.column() <= 0 ||
+                       (detailColumn >= 0 && topLeft.column() <= detailColumn && bottomRight.column() >= detailColumn);
+    if (!shownColumn)
+        return;
+
+    if (bottomRight.row() - topLeft.row() >= rows.size()) {
+        rows.clear();
+        return;
+    }
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+        rows.remove(row);
+}
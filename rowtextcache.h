@@ -0,0 +1,58 @@
+#ifndef ROWTEXTCACHE_H
+#define ROWTEXTCACHE_H
+
+#include <QCache>
+#include <QFont>
+#include <QObject>
+#include <QPointer>
+#include <QStaticText>
+#include <Qt>
+
+class QAbstractItemModel;
+class QModelIndex;
+class QPainter;
+class QRect;
+
+// Text layouts of the rows an item delegate has painted, so that repainting a row while scrolling only
+// draws it. A row is laid out again once the model reports a change to it, or the width or font it was
+// laid out for changes.
+class RowTextCache : public QObject {
+    Q_OBJECT
+public:
+    struct Row {
+        int width = -1;
+        QStaticText name;
+        QStaticText detail;
+    };
+
+    // detailColumn is the other column a row's text comes from, or -1; changes to the rest are ignored.
+    RowTextCache(const char* delegateName, int detailColumn, QObject* parent = nullptr);
+
+    // The row as laid out for width, or nullptr when the caller has to lay it out and insert() it.
+    const Row* find(const QModelIndex& index, int width, const QFont& font);
+    const Row* insert(const QModelIndex& index, const Row& row);
+
+    static QStaticText layout(const QString& text, const QFont& font);
+    // Centres text vertically in rect; horizontally it is aligned as alignment says.
+    static void draw(QPainter* painter, const QRect& rect, const QStaticText& text, Qt::Alignment alignment);
+
+    // Adds one paint() call to the timing logged under explosion.paint.
+    void recordPaint(qint64 nsecs);
+
+private:
+    const char* delegateName;
+    int detailColumn;
+    QPointer<const QAbstractItemModel> model;
+    QFont font;
+    QCache<int, Row> rows;
+    qint64 paints;
+    qint64 paintNsecs;
+    qint64 hits;
+    qint64 misses;
+
+    void track(const QAbstractItemModel* newModel);
+    void rowsChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    void shiftRows(int first, int last, int delta);
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "scanscheduler.h"
+#include "mounttable.h"
+#include <QFile>
+#include <QMutexLocker>
+#include <QThread>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+namespace {
+
+const int IDLE_WAIT_MS = 100;
+const int BUDGET_WAIT_MS = 50;
+const int SLOW_MOUNT_LIMIT = 4;
+
+bool readRotational(const QString& sysPath, bool* rotational) {
+    QFile file(sysPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    *rotational = file.readAll().trimmed() == "1";
+    return true;
+}
+
+}
+
+ScanScheduler::ScanScheduler(int workerCount, qint64 byteBudget)
+    : queuedTasks(0), nextQueue(0), stopping(false), budget(byteBudget), bytesInFlight(0) {
+    if (workerCount <= 0)
+        workerCount = QThread::idealThreadCount();
+
+    for (int i = 0; i < workerCount; ++i)
+        queues.push_back(std::make_unique<WorkerQueue>());
+
+    for (int i = 0; i < workerCount; ++i) {
+        QThread* worker = QThread::create([this, i]() { workerLoop(i); });
+        worker->start();
+        workers.append(worker);
+    }
+}
+
+ScanScheduler::~ScanScheduler() {
+    {
+        QMutexLocker locker(&idleMutex);
+        stopping = true;
+        idleCondition.wakeAll();
+    }
+    budgetCondition.wakeAll();
+
+    for (QThread* worker : workers) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+quint64 ScanScheduler::deviceOf(const QString& path) {
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) != 0)
+        return 0;
+    return quint64(st.st_dev);
+}
+
+int ScanScheduler::deviceLimit(quint64 device) const {
+    // Asked once per device. btrfs, tmpfs and overlayfs also get anonymous devices with major 0,
+    // so only the filesystem type tells a network or FUSE mount apart.
+    if (MountTable::read().mountForDevice(device).slow)
+        return SLOW_MOUNT_LIMIT;
+
+    unsigned int majorId = major(dev_t(device));
+    unsigned int minorId = minor(dev_t(device));
+    if (majorId == 0)
+        return int(queues.size());
+
+    QString base = QString("/sys/dev/block/%1:%2").arg(majorId).arg(minorId);
+    bool rotational = false;
+    if (!readRotational(base + "/queue/rotational", &rotational) &&
+        !readRotational(base + "/../queue/rotational", &rotational))
+        return int(queues.size());
+
+    return rotational ? 1 : int(queues.size());
+}
+
+bool ScanScheduler::acquireBytes(qint64 bytes, const std::atomic<bool>& cancelled) {
+    bytes = qBound<qint64>(0, bytes, budget);
+
+    QMutexLocker locker(&budgetMutex);
+    while (bytesInFlight > 0 && bytesInFlight + bytes > budget) {
+        if (cancelled.load() || stopping.load())
+            return false;
+        budgetCondition.wait(&budgetMutex, BUDGET_WAIT_MS);
+    }
+    bytesInFlight += bytes;
+    return true;
+}
+
+void ScanScheduler::releaseBytes(qint64 bytes) {
+    bytes = qBound<qint64>(0, bytes, budget);
+
+    QMutexLocker locker(&budgetMutex);
+    bytesInFlight -= bytes;
+    budgetCondition.wakeAll();
+}
+
+void ScanScheduler::submit(ScanTask task) {
+    task.bytes = qBound<qint64>(0, task.bytes, budget);
+    push(int(nextQueue.fetch_add(1) % queues.size()), std::move(task));
+}
+
+void ScanScheduler::push(int queue, ScanTask task) {
+    {
+        QMutexLocker locker(&queues[queue]->mutex);
+        queues[queue]->tasks.push_back(std::move(task));
+    }
+    queuedTasks.fetch_add(1);
+
+    QMutexLocker locker(&idleMutex);
+    idleCondition.wakeOne();
+}
+
+bool ScanScheduler::takeTask(int self, ScanTask& task) {
+    {
+        WorkerQueue& own = *queues[self];
+        QMutexLocker locker(&own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queuedTasks.fetch_sub(1);
+            return true;
+        }
+    }
+
+    int count = int(queues.size());
+    for (int offset = 1; offset < count; ++offset) {
+        WorkerQueue& victim = *queues[(self + offset) % count];
+        QMutexLocker locker(&victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queuedTasks.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ScanScheduler::enterDevice(ScanTask& task) {
+    QMutexLocker locker(&deviceMutex);
+    auto it = devices.find(task.device);
+    if (it == devices.end()) {
+        it = devices.insert(task.device, DeviceState());
+        it->limit = deviceLimit(task.device);
+    }
+
+    if (it->active < it->limit) {
+        ++it->active;
+        return true;
+    }
+
+    it->deferred.push_back(std::move(task));
+    return false;
+}
+
+void ScanScheduler::leaveDevice(quint64 device, int self) {
+    ScanTask next;
+    bool hasNext = false;
+    {
+        QMutexLocker locker(&deviceMutex);
+        DeviceState& state = devices[device];
+        --state.active;
+        if (!state.deferred.empty()) {
+            next = std::move(state.deferred.front());
+            state.deferred.pop_front();
+            hasNext = true;
+        }
+    }
+
+    if (hasNext)
+        push(self, std::move(next));
+}
+
+void ScanScheduler::workerLoop(int self) {
+    while (!stopping.load()) {
+        ScanTask task;
+        if (!takeTask(self, task)) {
+            QMutexLocker locker(&idleMutex);
+            if (!stopping.load() && queuedTasks.load() == 0)
+                idleCondition.wait(&idleMutex, IDLE_WAIT_MS);
+            continue;
+        }
+
+        if (!enterDevice(task))
+            continue;
+
+        quint64 device = task.device;
+        qint64 bytes = task.bytes;
+        task.run();
+        task = ScanTask();
+
+        leaveDevice(device, self);
+        releaseBytes(bytes);
+    }
+}
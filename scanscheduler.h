@@ -0,0 +1,72 @@
+#ifndef SCANSCHEDULER_H
+#define SCANSCHEDULER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class QThread;
+
+struct ScanTask {
+    std::function<void()> run;
+    quint64 device;
+    qint64 bytes;
+};
+
+class ScanScheduler {
+public:
+    explicit ScanScheduler(int workerCount = 0, qint64 byteBudget = 256 * 1024 * 1024);
+    ~ScanScheduler();
+
+    qint64 byteBudget() const { return budget; }
+
+    bool acquireBytes(qint64 bytes, const std::atomic<bool>& cancelled);
+
+    void submit(ScanTask task);
+
+    static quint64 deviceOf(const QString& path);
+
+private:
+    struct WorkerQueue {
+        QMutex mutex;
+        std::deque<ScanTask> tasks;
+    };
+
+    struct DeviceState {
+        int active = 0;
+        int limit = 1;
+        std::deque<ScanTask> deferred;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    QVector<QThread*> workers;
+    std::atomic<int> queuedTasks;
+    std::atomic<unsigned> nextQueue;
+    std::atomic<bool> stopping;
+    QMutex idleMutex;
+    QWaitCondition idleCondition;
+
+    qint64 budget;
+    qint64 bytesInFlight;
+    QMutex budgetMutex;
+    QWaitCondition budgetCondition;
+
+    QMutex deviceMutex;
+    QHash<quint64, DeviceState> devices;
+
+    void workerLoop(int self);
+    bool takeTask(int self, ScanTask& task);
+    void push(int queue, ScanTask task);
+    bool enterDevice(ScanTask& task);
+    void leaveDevice(quint64 device, int self);
+    void releaseBytes(qint64 bytes);
+    int deviceLimit(quint64 device) const;
+};
+
+#endif
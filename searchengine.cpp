@@ -0,0 +1,310 @@
+#include "searchengine.h"
+#include "searchplan.h"
+#include "scanscheduler.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+
+namespace {
+
+const int DRAIN_INTERVAL_MS = 50;
+const int LOCAL_BATCH_SIZE = 256;
+const int CANDIDATE_CHUNK_SIZE = 512;
+
+}
+
+struct SearchJob {
+    std::shared_ptr<const SearchPlan> plan;
+    QThreadPool* pool;
+    ScanScheduler* scanner;
+    std::atomic<bool> cancelled{false};
+    std::atomic<int> pendingTasks{0};
+    // Folders an index answer already covers; directory scans do not descend into them.
+    QHash<QString, qint64> indexedDirectories;
+    QMutex mutex;
+    QVector<SearchHit> pendingHits;
+
+    void scheduleDirectory(const std::shared_ptr<SearchJob>& self, const QString& path);
+
+    void scheduleCandidates(const std::shared_ptr<SearchJob>& self, const QStringList& paths);
+
+    void scheduleContentScan(const std::shared_ptr<SearchJob>& self, const QFileInfo& info, quint64 device);
+
+    SearchHit makeHit(const QFileInfo& info) const {
+        return SearchHit{info.absoluteFilePath(), info.fileName(),
+                         info.isDir() ? -1 : info.size(), info.lastModified(), info.isDir()};
+    }
+
+    void publish(QVector<SearchHit>& hits) {
+        if (hits.isEmpty())
+            return;
+        QMutexLocker locker(&mutex);
+        pendingHits += hits;
+        hits.clear();
+    }
+};
+
+class DirectoryScanTask : public QRunnable {
+public:
+    DirectoryScanTask(std::shared_ptr<SearchJob> job, const QString& path)
+        : job(std::move(job)), path(path) {}
+
+    void run() override {
+        if (!job->cancelled.load(std::memory_order_relaxed))
+            scan();
+        job->pendingTasks.fetch_sub(1);
+    }
+
+private:
+    std::shared_ptr<SearchJob> job;
+    QString path;
+
+    void scan() {
+        const SearchPlan& plan = *job->plan;
+        bool recursive = plan.criteria().includeSubdirectories;
+        quint64 device = plan.needsContent() ? ScanScheduler::deviceOf(path) : 0;
+        QVector<SearchHit> hits;
+
+        QDirIterator it(path, QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files);
+        while (it.hasNext()) {
+            if (job->cancelled.load(std::memory_order_relaxed))
+                return;
+
+            it.next();
+            QFileInfo info = it.fileInfo();
+
+            if (recursive && info.isDir() && !info.isSymLink() &&
+                !job->indexedDirectories.contains(info.absoluteFilePath()))
+                job->scheduleDirectory(job, info.absoluteFilePath());
+
+            if (!plan.matchesMetadata(info))
+                continue;
+
+            if (plan.needsContent()) {
+                job->scheduleContentScan(job, info, device);
+                continue;
+            }
+
+            hits.append(job->makeHit(info));
+
+            if (hits.size() >= LOCAL_BATCH_SIZE)
+                job->publish(hits);
+        }
+
+        job->publish(hits);
+    }
+};
+
+class CandidateScanTask : public QRunnable {
+public:
+    CandidateScanTask(std::shared_ptr<SearchJob> job, const QStringList& paths)
+        : job(std::move(job)), paths(paths) {}
+
+    void run() override {
+        QVector<SearchHit> hits;
+        for (const QString& path : paths) {
+            if (job->cancelled.load(std::memory_order_relaxed))
+                break;
+
+            QFileInfo info(path);
+            if (!info.exists() || !job->plan->matchesMetadata(info))
+                continue;
+
+            if (job->plan->needsContent()) {
+                job->scheduleContentScan(job, info, ScanScheduler::deviceOf(path));
+                continue;
+            }
+
+            hits.append(job->makeHit(info));
+        }
+        job->publish(hits);
+        job->pendingTasks.fetch_sub(1);
+    }
+
+private:
+    std::shared_ptr<SearchJob> job;
+    QStringList paths;
+};
+
+// An index is only as fresh as its build. A folder whose modification time moved since then gained, lost or
+// renamed entries, so it is listed again, and the index's candidates in it are dropped in favour of that.
+class IndexRevalidateTask : public QRunnable {
+public:
+    IndexRevalidateTask(std::shared_ptr<SearchJob> job, const QStringList& candidates)
+        : job(std::move(job)), candidates(candidates) {}
+
+    void run() override {
+        if (!job->cancelled.load(std::memory_order_relaxed))
+            revalidate();
+        job->pendingTasks.fetch_sub(1);
+    }
+
+private:
+    std::shared_ptr<SearchJob> job;
+    QStringList candidates;
+
+    void revalidate() {
+        QSet<QString> changed;
+        const QHash<QString, qint64>& directories = job->indexedDirectories;
+        for (auto it = directories.cbegin(); it != directories.cend(); ++it) {
+            if (job->cancelled.load(std::memory_order_relaxed))
+                return;
+            QFileInfo info(it.key());
+            if (!info.exists()) {
+                changed.insert(it.key());
+            } else if (info.lastModified().toMSecsSinceEpoch() != it.value()) {
+                changed.insert(it.key());
+                job->scheduleDirectory(job, it.key());
+            }
+        }
+
+        QStringList fresh;
+        if (changed.isEmpty()) {
+            fresh = candidates;
+        } else {
+            for (const QString& path : std::as_const(candidates)) {
+                qsizetype slash = path.lastIndexOf(QLatin1Char('/'));
+                if (!changed.contains(slash > 0 ? path.left(slash) : QStringLiteral("/")))
+                    fresh.append(path);
+            }
+        }
+        for (qsizetype i = 0; i < fresh.size(); i += CANDIDATE_CHUNK_SIZE)
+            job->scheduleCandidates(job, fresh.mid(i, CANDIDATE_CHUNK_SIZE));
+    }
+};
+
+void SearchJob::scheduleDirectory(const std::shared_ptr<SearchJob>& self, const QString& path) {
+    pendingTasks.fetch_add(1);
+    pool->start(new DirectoryScanTask(self, path));
+}
+
+void SearchJob::scheduleCandidates(const std::shared_ptr<SearchJob>& self, const QStringList& paths) {
+    pendingTasks.fetch_add(1);
+    pool->start(new CandidateScanTask(self, paths));
+}
+
+void SearchJob::scheduleContentScan(const std::shared_ptr<SearchJob>& self, const QFileInfo& info, quint64 device) {
+    qint64 bytes = info.size();
+    if (!scanner->acquireBytes(bytes, cancelled))
+        return;
+
+    pendingTasks.fetch_add(1);
+    SearchHit hit = makeHit(info);
+    scanner->submit({[self, hit]() {
+        QStringList members;
+        if (!self->cancelled.load(std::memory_order_relaxed) &&
+            self->plan->contentMatches(hit.path, &members, &self->cancelled)) {
+            QVector<SearchHit> hits;
+            for (const QString& member : members) {
+                hits.append(hit);
+                hits.last().member = member;
+            }
+            self->publish(hits);
+        }
+        self->pendingTasks.fetch_sub(1);
+    }, device, bytes});
+}
+
+SearchEngine::SearchEngine(QObject* parent)
+    : QObject(parent), pool(new QThreadPool(this)), scanner(new ScanScheduler()),
+      drainTimer(new QTimer(this)), totalResults(0) {
+    pool->setMaxThreadCount(qMax(4, QThread::idealThreadCount()));
+
+    drainTimer->setInterval(DRAIN_INTERVAL_MS);
+    connect(drainTimer, &QTimer::timeout, this, &SearchEngine::drainResults);
+}
+
+SearchEngine::~SearchEngine() {
+    cancel();
+    pool->waitForDone();
+    delete scanner;
+}
+
+void SearchEngine::start(const SearchCriteria& criteria) {
+    startJob(criteria);
+    job->scheduleDirectory(job, criteria.path);
+}
+
+void SearchEngine::start(const SearchCriteria& criteria, const QStringList& candidates,
+                         const QHash<QString, qint64>& directories) {
+    startJob(criteria);
+    // A base folder created after the build has nothing indexed under it.
+    if (!directories.contains(QDir::cleanPath(criteria.path))) {
+        job->scheduleDirectory(job, criteria.path);
+        return;
+    }
+    job->indexedDirectories = directories;
+    // Stat'ing the folders can stall on a busy disk, so even that happens on the pool.
+    job->pendingTasks.fetch_add(1);
+    pool->start(new IndexRevalidateTask(job, candidates));
+}
+
+void SearchEngine::startJob(const SearchCriteria& criteria) {
+    cancel();
+
+    job = std::make_shared<SearchJob>();
+    job->plan = SearchPlan::compile(criteria);
+    job->pool = pool;
+    job->scanner = scanner;
+    totalResults = 0;
+
+    drainTimer->start();
+}
+
+void SearchEngine::cancel() {
+    if (!job)
+        return;
+
+    job->cancelled = true;
+    pool->clear();
+    drainTimer->stop();
+    job.reset();
+}
+
+bool SearchEngine::isRunning() const {
+    return job != nullptr;
+}
+
+int SearchEngine::resultCount() const {
+    return totalResults;
+}
+
+void SearchEngine::drainResults() {
+    std::shared_ptr<SearchJob> current = job;
+    if (!current)
+        return;
+
+    bool done = current->pendingTasks.load() == 0;
+
+    // Fuzzy hits are ranked as a whole, so they are held back until the walk completes.
+    if (current->plan->isFuzzy() && !done)
+        return;
+
+    QVector<SearchHit> batch;
+    {
+        QMutexLocker locker(&current->mutex);
+        batch.swap(current->pendingHits);
+    }
+    current->plan->rank(batch);
+
+    if (!batch.isEmpty()) {
+        totalResults += batch.size();
+        emit resultsReady(batch);
+        if (job != current)
+            return;
+    }
+
+    if (done) {
+        drainTimer->stop();
+        job.reset();
+        emit finished(totalResults);
+    }
+}
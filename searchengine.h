@@ -0,0 +1,65 @@
+#ifndef SEARCHENGINE_H
+#define SEARCHENGINE_H
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QDateTime>
+#include <QVector>
+#include <memory>
+
+#include "searchmanager.h"
+
+class QThreadPool;
+class QTimer;
+class ScanScheduler;
+
+struct SearchHit {
+    QString path;
+    QString name;
+    qint64 size;
+    QDateTime lastModified;
+    bool isDir;
+    QString member;
+};
+
+struct SearchJob;
+
+class SearchEngine : public QObject {
+    Q_OBJECT
+public:
+    explicit SearchEngine(QObject* parent = nullptr);
+    ~SearchEngine();
+
+    void start(const SearchCriteria& criteria);
+
+    // Checks the index's candidates instead of walking the tree. directories are the indexed folders the
+    // search covers with their indexed modification times; those changed since are listed again.
+    void start(const SearchCriteria& criteria, const QStringList& candidates,
+               const QHash<QString, qint64>& directories);
+
+    void cancel();
+
+    bool isRunning() const;
+
+    int resultCount() const;
+
+signals:
+    void resultsReady(const QVector<SearchHit>& hits);
+
+    void finished(int resultCount);
+
+private slots:
+    void drainResults();
+
+private:
+    void startJob(const SearchCriteria& criteria);
+
+    QThreadPool* pool;
+    ScanScheduler* scanner;
+    QTimer* drainTimer;
+    std::shared_ptr<SearchJob> job;
+    int totalResults;
+};
+
+#endif
@@ -1,16 +1,62 @@
 #include "searchmanager.h"
+#include "searchengine.h"
+#include "searchresultsmodel.h"
+#include "filenameindex.h"
+#include "mounttable.h"
+#include "searchplan.h"
+#include <QSettings>
 #include <QDirIterator>
-#include <QTextStream>
-#include <QFile>
+#include <QTimer>
+
+namespace {
+
+const int DEBOUNCE_INTERVAL_MS = 150;
+
+}
 
 SearchManager::SearchManager(QObject* parent)
-    : QObject(parent), searchActive(false) {
+    : QObject(parent), searchActive(false),
+      engine(new SearchEngine(this)), results(new SearchResultsModel(this)),
+      index(nullptr), usedIndex(false), resultsComplete(false), debounceTimer(new QTimer(this)) {
     searchCriteria.caseSensitive = false;
     searchCriteria.useRegex = false;
+    searchCriteria.fuzzy = false;
     searchCriteria.searchContents = false;
     searchCriteria.includeSubdirectories = true;
-    searchCriteria.sizeFrom = 0;
-    searchCriteria.sizeTo = 0; 
+    searchCriteria.sizeFrom = -1;
+    searchCriteria.sizeTo = -1;
+    
+    connect(engine, &SearchEngine::resultsReady, results, &SearchResultsModel::appendResults);
+    connect(engine, &SearchEngine::finished, this, &SearchManager::onEngineFinished);
+    
+    debounceTimer->setSingleShot(true);
+    debounceTimer->setInterval(DEBOUNCE_INTERVAL_MS);
+    connect(debounceTimer, &QTimer::timeout, this, &SearchManager::onDebounceTimeout);
+    
+    setupFilenameIndex();
+}
+
+void SearchManager::setupFilenameIndex() {
+    QSettings settings("Explosion", "Explosion");
+    if (!settings.value("index/enabled", false).toBool())
+        return;
+    
+    index = new FilenameIndex(this);
+    index->setRoots(settings.value("index/roots", QStringList{QDir::homePath()}).toStringList());
+    index->setMaxAge(settings.value("index/maxAgeHours", 24).toLongLong() * 3600);
+    
+    if (!index->load() || index->isStale())
+        index->rebuild();
+}
+
+bool SearchManager::canAnswerFromIndex() const {
+    if (!index || searchCriteria.text.isEmpty() || searchCriteria.useRegex || searchCriteria.searchContents)
+        return false;
+    // Revalidating an index answer stats every folder under the base, which a slow mount cannot afford.
+    if (MountTable::isSlowPath(searchCriteria.path))
+        return false;
+    
+    return index->covers(searchCriteria.path);
 }
 
 void SearchManager::setBaseDirectory(const QString& directory) {
@@ -23,6 +69,8 @@ QString SearchManager::baseDirectory() const {
 
 void SearchManager::setCriteria(const SearchCriteria& criteria) {
     searchCriteria = criteria;
+    queryText = criteria.text;
+    plan.reset();
 }
 
 SearchCriteria SearchManager::criteria() const {
@@ -30,44 +78,145 @@ SearchCriteria SearchManager::criteria() const {
 }
 
 QString SearchManager::lastQuery() const {
-    return searchCriteria.text;
+    return queryText;
 }
 
 void SearchManager::quickSearch(const QString& query) {
+    debounceTimer->stop();
+    
     if (query.isEmpty()) {
         clearSearch();
         return;
     }
     
-    searchCriteria.text = query;
+    searchCriteria = SearchPlan::parseQuery(query, searchCriteria);
     searchCriteria.path = baseDir;
+    queryText = query;
+    plan.reset();
     
-    currentSearchFilters = createFilters(query);
+    currentSearchFilters = createFilters(searchCriteria.text);
     searchActive = true;
     
     emit searchStarted();
-    emit searchFilterChanged(currentSearchFilters, true);
+    if (!searchCriteria.includeSubdirectories)
+        emit searchFilterChanged(currentSearchFilters, true);
     
-    emit searchFinished(-1);
+    startEngine();
+}
+
+void SearchManager::incrementalSearch(const QString& query) {
+    if (query.isEmpty()) {
+        debounceTimer->stop();
+        if (searchActive)
+            clearSearch();
+        return;
+    }
+    
+    if (refineResults(query)) {
+        debounceTimer->stop();
+        return;
+    }
+    
+    // The running scan answers a query the user has already typed past.
+    engine->cancel();
+    resultsComplete = false;
+    
+    pendingQuery = query;
+    debounceTimer->start();
+}
+
+void SearchManager::onDebounceTimeout() {
+    quickSearch(pendingQuery);
+}
+
+bool SearchManager::refineResults(const QString& query) {
+    if (!searchActive || !resultsComplete || engine->isRunning())
+        return false;
+    
+    // A truncated fuzzy ranking is not a superset of the narrower query's matches.
+    if (searchCriteria.fuzzy && results->rowCount() >= SearchPlan::FuzzyResultLimit)
+        return false;
+    
+    SearchCriteria next = SearchPlan::parseQuery(query, searchCriteria);
+    next.path = baseDir;
+    if (!searchCriteria.includeSubdirectories || !SearchPlan::narrows(searchCriteria, next))
+        return false;
+    
+    searchCriteria = next;
+    queryText = query;
+    plan = SearchPlan::compile(searchCriteria);
+    currentSearchFilters = createFilters(searchCriteria.text);
+    
+    results->refine(*plan);
+    emit searchFinished(results->rowCount());
+    return true;
 }
 
 void SearchManager::advancedSearch() {
-    if (searchCriteria.text.isEmpty() && searchCriteria.fileTypes.isEmpty() &&
+    debounceTimer->stop();
+    
+
+    if (searchCriteria.text.isEmpty() && searchCriteria.contentText.isEmpty() &&
+        searchCriteria.fileTypes.isEmpty() &&
         !searchCriteria.dateFrom.isValid() && !searchCriteria.dateTo.isValid() &&
-        searchCriteria.sizeFrom <= 0 && searchCriteria.sizeTo <= 0) {
+        searchCriteria.sizeFrom < 0 && searchCriteria.sizeTo < 0) {
         clearSearch();
         return;
     }
     
+    if (searchCriteria.path.isEmpty())
+        searchCriteria.path = baseDir;
+    
     searchActive = true;
     emit searchStarted();
     
     currentSearchFilters = createFilters(searchCriteria.text);
-    emit searchFilterChanged(currentSearchFilters, true);
+    if (!searchCriteria.includeSubdirectories)
+        emit searchFilterChanged(currentSearchFilters, true);
+    
+    startEngine();
+}
+
+void SearchManager::startEngine() {
+    results->clear();
+    resultsComplete = false;
+    
+    usedIndex = canAnswerFromIndex();
+    if (usedIndex && searchCriteria.fuzzy) {
+        // Other filters may reject top-ranked names, so only cap the candidates when the name decides alone.
+        bool nameOnly = searchCriteria.fileTypes.isEmpty() && searchCriteria.sizeFrom < 0 &&
+                        searchCriteria.sizeTo < 0 && !searchCriteria.dateFrom.isValid() &&
+                        !searchCriteria.dateTo.isValid();
+        QStringList candidates = index->fuzzyQuery(searchCriteria.text, searchCriteria.path,
+                                                   searchCriteria.includeSubdirectories,
+                                                   nameOnly ? SearchPlan::FuzzyResultLimit : 0);
+        engine->start(searchCriteria, candidates,
+                      index->directories(searchCriteria.path, searchCriteria.includeSubdirectories));
+    } else if (usedIndex) {
+        QStringList candidates = index->query(searchCriteria.text, searchCriteria.path,
+                                              searchCriteria.includeSubdirectories,
+                                              searchCriteria.caseSensitive);
+        engine->start(searchCriteria, candidates,
+                      index->directories(searchCriteria.path, searchCriteria.includeSubdirectories));
+    } else {
+        if (index && !index->isBuilding() && index->isStale())
+            index->rebuild();
+        engine->start(searchCriteria);
+    }
+    
     emit searchFinished(-1);
 }
 
+void SearchManager::onEngineFinished(int resultCount) {
+    resultsComplete = true;
+    emit searchFinished(resultCount);
+}
+
 void SearchManager::clearSearch() {
+    debounceTimer->stop();
+    engine->cancel();
+    resultsComplete = false;
+    results->clear();
     searchActive = false;
     currentSearchFilters.clear();
     emit searchCleared();
@@ -103,88 +252,7 @@ bool SearchManager::matchesCriteria(const QFileInfo& fileInfo) const {
     if (!searchActive)
         return true;
     
-    QString filename = fileInfo.fileName();
-    
-    if (!searchCriteria.text.isEmpty()) {
-        if (searchCriteria.useRegex) {
-            QRegularExpression regex(
-                searchCriteria.text,
-                searchCriteria.caseSensitive ? QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption
-            );
-            if (!regex.match(filename).hasMatch())
-                return false;
-        } else {
-            Qt::CaseSensitivity cs = searchCriteria.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
-            if (!filename.contains(searchCriteria.text, cs))
-                return false;
-        }
-    }
-    
-    if (fileInfo.isDir())
-        return true;
-    
-    
-    if (!searchCriteria.fileTypes.isEmpty()) {
-        QString suffix = fileInfo.suffix().toLower();
-        bool matchesType = false;
-        for (const QString& type : searchCriteria.fileTypes) {
-            if (suffix == type.toLower()) {
-                matchesType = true;
-                break;
-            }
-        }
-        if (!matchesType)
-            return false;
-    }
-    
-    if (searchCriteria.sizeFrom > 0 && fileInfo.size() < searchCriteria.sizeFrom)
-        return false;
-    
-    if (searchCriteria.sizeTo > 0 && fileInfo.size() > searchCriteria.sizeTo)
-        return false;
-    
-    if (searchCriteria.dateFrom.isValid() && fileInfo.lastModified() < searchCriteria.dateFrom)
-        return false;
-    
-    if (searchCriteria.dateTo.isValid() && fileInfo.lastModified() > searchCriteria.dateTo)
-        return false;
-    
-    if (searchCriteria.searchContents && !searchCriteria.text.isEmpty()) {
-        return fileContainsText(fileInfo.absoluteFilePath(), searchCriteria.text);
-    }
-    
-    return true;
+    if (!plan)
+        plan = SearchPlan::compile(searchCriteria);
+    return plan->matches(fileInfo);
 }
-
-bool SearchManager::fileContainsText(const QString& filePath, const QString& text) const {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
-        return false;
-        
-    QTextStream in(&file);
-    const int CHUNK_SIZE = 8192; 
-    QString chunk;
-    
-    Qt::CaseSensitivity cs = searchCriteria.caseSensitive ? 
-                             Qt::CaseSensitive : Qt::CaseInsensitive;
-    
-    if (searchCriteria.useRegex) {
-        QRegularExpression regex(
-            text,
-            searchCriteria.caseSensitive ? 
-            QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption
-        );
-        
-        while (!(chunk = in.read(CHUNK_SIZE)).isEmpty()) {
-            if (regex.match(chunk).hasMatch())
-                return true;
-        }
-    } else {
-        while (!(chunk = in.read(CHUNK_SIZE)).isEmpty()) {
-            if (chunk.contains(text, cs))
-                return true;
-        }
-    }
-    
-    return false;
-}
\ No newline at end of file
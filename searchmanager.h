@@ -10,21 +10,31 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QRegularExpression>
+#include <memory>
 
 struct SearchCriteria {
     QString text;
+    QString contentText;
     QString path;
     QDateTime dateFrom;
     QDateTime dateTo;
+    // Inclusive byte bounds, -1 when unbounded; 0 is a real bound.
     qint64 sizeFrom;
     qint64 sizeTo;
     QStringList fileTypes;
     bool caseSensitive;
     bool useRegex;
+    bool fuzzy;
     bool searchContents;
     bool includeSubdirectories;
 };
 
+class QTimer;
+class SearchEngine;
+class SearchResultsModel;
+class FilenameIndex;
+class SearchPlan;
+
 class SearchManager : public QObject {
     Q_OBJECT
 public:
@@ -42,6 +52,8 @@ public:
     
     void quickSearch(const QString& query);
     
+    void incrementalSearch(const QString& query);
+    
     void advancedSearch();
     
     void clearSearch();
@@ -51,6 +63,12 @@ public:
     QStringList currentFilters() const;
     
     bool matchesCriteria(const QFileInfo& fileInfo) const;
+    
+    SearchResultsModel* resultsModel() const { return results; }
+    
+    FilenameIndex* filenameIndex() const { return index; }
+    
+    bool lastSearchUsedIndex() const { return usedIndex; }
 
 signals:
     void searchFilterChanged(const QStringList& filters, bool hideNonMatching);
@@ -61,17 +79,35 @@ signals:
     
     void searchCleared();
 
+private slots:
+    void onEngineFinished(int resultCount);
+    
+    void onDebounceTimeout();
+
 private:
     QString baseDir;
     SearchCriteria searchCriteria;
     bool searchActive;
+    QString queryText;
     QStringList currentSearchFilters;
+    mutable std::shared_ptr<const SearchPlan> plan;
+    SearchEngine* engine;
+    SearchResultsModel* results;
+    FilenameIndex* index;
+    bool usedIndex;
+    bool resultsComplete;
+    QTimer* debounceTimer;
+    QString pendingQuery;
     
     QStringList createFilters(const QString& text) const;
     
-    bool fileMatchesAdvancedCriteria(const QFileInfo& fileInfo) const;
+    void startEngine();
+    
+    void setupFilenameIndex();
+    
+    bool canAnswerFromIndex() const;
     
-    bool fileContainsText(const QString& filePath, const QString& text) const;
+    bool refineResults(const QString& query);
 };
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,468 @@
+#include "searchplan.h"
+#include "archivereader.h"
+#include "searchengine.h"
+#include <QDate>
+#include <QDateTime>
+#include <QRegularExpressionMatch>
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace {
+
+class FileInfoEntry {
+public:
+    explicit FileInfoEntry(const QFileInfo& info)
+        : info(info), name(info.fileName()), dirState(-1) {}
+
+    const QString& fileName() const { return name; }
+
+    bool isDir() const {
+        if (dirState < 0)
+            dirState = info.isDir() ? 1 : 0;
+        return dirState == 1;
+    }
+
+    qint64 size() const { return info.size(); }
+    qint64 modifiedMsecs() const { return info.lastModified().toMSecsSinceEpoch(); }
+    QString filePath() const { return info.absoluteFilePath(); }
+
+private:
+    const QFileInfo& info;
+    QString name;
+    mutable int dirState;
+};
+
+class HitEntry {
+public:
+    explicit HitEntry(const SearchHit& hit) : hit(hit) {}
+
+    const QString& fileName() const { return hit.name; }
+    bool isDir() const { return hit.isDir; }
+    qint64 size() const { return hit.size; }
+    qint64 modifiedMsecs() const { return hit.lastModified.toMSecsSinceEpoch(); }
+    QString filePath() const { return hit.path; }
+
+private:
+    const SearchHit& hit;
+};
+
+QStringList tokenize(const QString& query) {
+    QStringList tokens;
+    QString current;
+    bool quoted = false;
+    bool hadQuotes = false;
+
+    for (QChar c : query) {
+        if (c == QLatin1Char('"')) {
+            quoted = !quoted;
+            hadQuotes = true;
+            current += c;
+        } else if (c.isSpace() && !quoted) {
+            if (!current.isEmpty() || hadQuotes)
+                tokens << current;
+            current.clear();
+            hadQuotes = false;
+        } else {
+            current += c;
+        }
+    }
+    if (!current.isEmpty())
+        tokens << current;
+    return tokens;
+}
+
+QString unquote(const QString& value) {
+    if (value.size() >= 2 && value.startsWith(QLatin1Char('"')) && value.endsWith(QLatin1Char('"')))
+        return value.mid(1, value.size() - 2);
+    return value;
+}
+
+bool parseSize(QString text, qint64* bytes) {
+    text = text.trimmed().toUpper();
+    qint64 multiplier = 1;
+    static const struct { const char* suffix; qint64 factor; } units[] = {
+        {"TB", 1LL << 40}, {"GB", 1LL << 30}, {"MB", 1LL << 20}, {"KB", 1LL << 10},
+        {"T", 1LL << 40}, {"G", 1LL << 30}, {"M", 1LL << 20}, {"K", 1LL << 10}, {"B", 1}
+    };
+    for (const auto& unit : units) {
+        if (text.endsWith(QLatin1String(unit.suffix))) {
+            multiplier = unit.factor;
+            text.chop(int(qstrlen(unit.suffix)));
+            break;
+        }
+    }
+
+    bool ok = false;
+    double value = text.trimmed().toDouble(&ok);
+    if (!ok || value < 0)
+        return false;
+    *bytes = qint64(value * double(multiplier));
+    return true;
+}
+
+bool parseAge(const QString& text, QDateTime* when) {
+    QDate date = QDate::fromString(text, Qt::ISODate);
+    if (date.isValid()) {
+        *when = date.startOfDay();
+        return true;
+    }
+
+    if (text.size() < 2)
+        return false;
+
+    bool ok = false;
+    qint64 amount = text.left(text.size() - 1).toLongLong(&ok);
+    if (!ok || amount < 0)
+        return false;
+
+    QDateTime now = QDateTime::currentDateTime();
+    switch (text.back().toLatin1()) {
+        case 'm': *when = now.addSecs(-amount * 60); return true;
+        case 'h': *when = now.addSecs(-amount * 3600); return true;
+        case 'd': *when = now.addDays(-amount); return true;
+        case 'w': *when = now.addDays(-amount * 7); return true;
+        case 'y': *when = now.addYears(-int(amount)); return true;
+    }
+    return false;
+}
+
+bool applySize(const QString& value, SearchCriteria& criteria) {
+    qint64 from = 0;
+    qint64 to = 0;
+    int range = value.indexOf(QLatin1String(".."));
+    if (range >= 0) {
+        if (!parseSize(value.left(range), &from) || !parseSize(value.mid(range + 2), &to))
+            return false;
+        criteria.sizeFrom = from;
+        criteria.sizeTo = to;
+        return true;
+    }
+
+    if (value.startsWith(QLatin1String(">="))) {
+        if (!parseSize(value.mid(2), &from)) return false;
+        criteria.sizeFrom = from;
+    } else if (value.startsWith(QLatin1Char('>'))) {
+        if (!parseSize(value.mid(1), &from)) return false;
+        criteria.sizeFrom = from + 1;
+    } else if (value.startsWith(QLatin1String("<="))) {
+        if (!parseSize(value.mid(2), &to)) return false;
+        criteria.sizeTo = to;
+    } else if (value.startsWith(QLatin1Char('<'))) {
+        if (!parseSize(value.mid(1), &to)) return false;
+        // Nothing is smaller than zero bytes, which leaves an empty range.
+        if (to <= 0)
+            criteria.sizeFrom = 1;
+        criteria.sizeTo = qMax<qint64>(to - 1, 0);
+    } else {
+        if (!parseSize(value.startsWith(QLatin1Char('=')) ? value.mid(1) : value, &from)) return false;
+        criteria.sizeFrom = from;
+        criteria.sizeTo = from;
+    }
+    return true;
+}
+
+bool applyModified(const QString& value, SearchCriteria& criteria) {
+    QDateTime when;
+    bool absolute = QDate::fromString(value.mid(value.startsWith(QLatin1Char('<')) || value.startsWith(QLatin1Char('>')) ? 1 : 0),
+                                      Qt::ISODate).isValid();
+
+    if (value.startsWith(QLatin1Char('<'))) {
+        if (!parseAge(value.mid(1), &when)) return false;
+        if (absolute)
+            criteria.dateTo = when;
+        else
+            criteria.dateFrom = when;
+    } else if (value.startsWith(QLatin1Char('>'))) {
+        if (!parseAge(value.mid(1), &when)) return false;
+        if (absolute)
+            criteria.dateFrom = when;
+        else
+            criteria.dateTo = when;
+    } else {
+        if (!parseAge(value, &when)) return false;
+        if (absolute) {
+            criteria.dateFrom = when;
+            criteria.dateTo = when.addDays(1).addMSecs(-1);
+        } else {
+            criteria.dateFrom = when;
+        }
+    }
+    return true;
+}
+
+}
+
+size_t SearchPlan::ExtensionHash::operator()(QStringView s) const {
+    size_t hash = 1469598103934665603ULL;
+    for (QChar c : s) {
+        hash ^= c.toLower().unicode();
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool SearchPlan::ExtensionEqual::operator()(QStringView a, QStringView b) const {
+    return a.compare(b, Qt::CaseInsensitive) == 0;
+}
+
+std::shared_ptr<const SearchPlan> SearchPlan::compile(const SearchCriteria& criteria) {
+    return std::shared_ptr<const SearchPlan>(new SearchPlan(criteria));
+}
+
+SearchPlan::SearchPlan(const SearchCriteria& criteria)
+    : source(criteria), hasNameText(false),
+      modifiedFrom(std::numeric_limits<qint64>::min()),
+      modifiedTo(std::numeric_limits<qint64>::max()) {
+    QString namePattern = criteria.text;
+    QString contentPattern = criteria.contentText;
+    if (contentPattern.isEmpty() && criteria.searchContents) {
+        contentPattern = namePattern;
+        namePattern.clear();
+    }
+
+    hasNameText = !namePattern.isEmpty();
+    if (hasNameText) {
+        if (criteria.fuzzy && !criteria.useRegex) {
+            fuzzy = FuzzyMatcher(namePattern);
+        } else if (criteria.useRegex) {
+            nameRegex = QRegularExpression(namePattern, criteria.caseSensitive
+                ? QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption);
+            nameRegex.optimize();
+        } else {
+            nameMatcher.setPattern(namePattern);
+            nameMatcher.setCaseSensitivity(criteria.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+        }
+        stages.push_back(Stage::Name);
+    }
+
+    for (const QString& type : criteria.fileTypes) {
+        QString extension = type.trimmed();
+        while (extension.startsWith(QLatin1Char('*')) || extension.startsWith(QLatin1Char('.')))
+            extension.remove(0, 1);
+        if (!extension.isEmpty())
+            extensionStorage << extension;
+    }
+    for (const QString& extension : std::as_const(extensionStorage))
+        extensions.insert(QStringView(extension));
+    if (!extensions.empty())
+        stages.push_back(Stage::Extension);
+
+    if (criteria.sizeFrom >= 0 || criteria.sizeTo >= 0)
+        stages.push_back(Stage::Size);
+
+    if (criteria.dateFrom.isValid())
+        modifiedFrom = criteria.dateFrom.toMSecsSinceEpoch();
+    if (criteria.dateTo.isValid())
+        modifiedTo = criteria.dateTo.toMSecsSinceEpoch();
+    if (criteria.dateFrom.isValid() || criteria.dateTo.isValid())
+        stages.push_back(Stage::Modified);
+
+    if (!contentPattern.isEmpty()) {
+        content = ContentMatcher(contentPattern, criteria.caseSensitive, criteria.useRegex);
+        stages.push_back(Stage::Content);
+    }
+
+    int nameCost = criteria.useRegex ? 5 : fuzzy.isValid() ? 3 : 2;
+    auto cost = [nameCost](Stage stage) {
+        switch (stage) {
+            case Stage::Extension: return 1;
+            case Stage::Name: return nameCost;
+            case Stage::Size: return 10;
+            case Stage::Modified: return 11;
+            case Stage::Content: return 100;
+        }
+        return 100;
+    };
+    std::stable_sort(stages.begin(), stages.end(), [&cost](Stage a, Stage b) {
+        return cost(a) < cost(b);
+    });
+}
+
+bool SearchPlan::matchesName(const QString& name) const {
+    if (!hasNameText)
+        return true;
+    if (fuzzy.isValid())
+        return fuzzy.score(name) != FuzzyMatcher::NoMatch;
+    if (source.useRegex)
+        return nameRegex.match(name).hasMatch();
+    return nameMatcher.indexIn(name) >= 0;
+}
+
+void SearchPlan::rank(QVector<SearchHit>& hits) const {
+    if (!fuzzy.isValid() || hits.isEmpty())
+        return;
+
+    QByteArray blob;
+    std::vector<quint64> offsets;
+    offsets.reserve(size_t(hits.size()) + 1);
+    offsets.push_back(0);
+    for (const SearchHit& hit : std::as_const(hits)) {
+        blob += FuzzyMatcher::fold(hit.name);
+        offsets.push_back(quint64(blob.size()));
+    }
+
+    std::vector<FuzzyMatcher::Candidate> ranked =
+        fuzzy.rank(blob.constData(), offsets.data(), quint64(hits.size()), FuzzyResultLimit);
+
+    QVector<SearchHit> ordered;
+    ordered.reserve(qsizetype(ranked.size()));
+    for (const FuzzyMatcher::Candidate& candidate : ranked)
+        ordered.append(std::move(hits[qsizetype(candidate.id)]));
+    hits.swap(ordered);
+}
+
+bool SearchPlan::matches(const QFileInfo& fileInfo) const {
+    return evaluate(FileInfoEntry(fileInfo), true);
+}
+
+bool SearchPlan::matchesMetadata(const QFileInfo& fileInfo) const {
+    return evaluate(FileInfoEntry(fileInfo), false);
+}
+
+bool SearchPlan::contentMatches(const QString& filePath, QStringList* members,
+                                const std::atomic<bool>* cancelled) const {
+    QStringList archiveMembers;
+    if (ArchiveReader::scan(filePath, content, &archiveMembers, cancelled)) {
+        if (members)
+            *members = archiveMembers;
+        return !archiveMembers.isEmpty();
+    }
+
+    bool found = content.matchesFile(filePath);
+    if (found && members)
+        *members = QStringList{QString()};
+    return found;
+}
+
+bool SearchPlan::matchesHit(const SearchHit& hit) const {
+    return evaluate(HitEntry(hit), false);
+}
+
+template <typename Entry>
+bool SearchPlan::evaluate(const Entry& entry, bool readContent) const {
+    const QString& name = entry.fileName();
+
+    for (Stage stage : stages) {
+        switch (stage) {
+            case Stage::Extension: {
+                if (entry.isDir())
+                    break;
+                QStringView view(name);
+                qsizetype dot = view.lastIndexOf(QLatin1Char('.'));
+                if (dot < 0 || extensions.find(view.mid(dot + 1)) == extensions.end())
+                    return false;
+                break;
+            }
+            case Stage::Name:
+                if (!matchesName(name))
+                    return false;
+                break;
+            case Stage::Size: {
+                if (entry.isDir())
+                    break;
+                qint64 size = entry.size();
+                if (source.sizeFrom >= 0 && size < source.sizeFrom)
+                    return false;
+                if (source.sizeTo >= 0 && size > source.sizeTo)
+                    return false;
+                break;
+            }
+            case Stage::Modified: {
+                if (entry.isDir())
+                    break;
+                qint64 modified = entry.modifiedMsecs();
+                if (modified < modifiedFrom || modified > modifiedTo)
+                    return false;
+                break;
+            }
+            case Stage::Content:
+                if (entry.isDir())
+                    return false;
+                return !readContent || contentMatches(entry.filePath());
+        }
+    }
+
+    return true;
+}
+
+bool SearchPlan::narrows(const SearchCriteria& previous, const SearchCriteria& next) {
+    if (previous.path != next.path || previous.includeSubdirectories != next.includeSubdirectories ||
+        previous.caseSensitive != next.caseSensitive || previous.useRegex || next.useRegex ||
+        previous.fuzzy != next.fuzzy ||
+        previous.searchContents != next.searchContents || previous.contentText != next.contentText)
+        return false;
+
+    Qt::CaseSensitivity cs = next.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    bool textIsContent = previous.searchContents && previous.contentText.isEmpty();
+    if (textIsContent ? previous.text != next.text : !next.text.contains(previous.text, cs))
+        return false;
+
+    if (!previous.fileTypes.isEmpty()) {
+        if (next.fileTypes.isEmpty())
+            return false;
+        for (const QString& type : next.fileTypes) {
+            if (!previous.fileTypes.contains(type, Qt::CaseInsensitive))
+                return false;
+        }
+    }
+
+    auto lower = [](qint64 from) { return from >= 0 ? from : 0; };
+    auto upper = [](qint64 to) { return to >= 0 ? to : std::numeric_limits<qint64>::max(); };
+    if (lower(next.sizeFrom) < lower(previous.sizeFrom) || upper(next.sizeTo) > upper(previous.sizeTo))
+        return false;
+
+    if (previous.dateFrom.isValid() && (!next.dateFrom.isValid() || next.dateFrom < previous.dateFrom))
+        return false;
+    if (previous.dateTo.isValid() && (!next.dateTo.isValid() || next.dateTo > previous.dateTo))
+        return false;
+
+    return true;
+}
+
+SearchCriteria SearchPlan::parseQuery(const QString& query, SearchCriteria criteria) {
+    criteria.text.clear();
+    criteria.contentText.clear();
+    criteria.fileTypes.clear();
+    criteria.sizeFrom = -1;
+    criteria.sizeTo = -1;
+    criteria.dateFrom = QDateTime();
+    criteria.dateTo = QDateTime();
+    criteria.fuzzy = false;
+
+    QStringList words;
+    for (const QString& token : tokenize(query)) {
+        if (token.size() > 1 && token.startsWith(QLatin1Char('~'))) {
+            criteria.fuzzy = true;
+            words << token.mid(1);
+            continue;
+        }
+
+        if (token.startsWith(QLatin1Char('"'))) {
+            QString phrase = unquote(token);
+            if (!phrase.isEmpty())
+                criteria.contentText = phrase;
+            continue;
+        }
+
+        int colon = token.indexOf(QLatin1Char(':'));
+        QString key = colon > 0 ? token.left(colon).toLower() : QString();
+        QString value = colon > 0 ? unquote(token.mid(colon + 1)) : QString();
+
+        bool consumed = false;
+        if (key == QLatin1String("ext") || key == QLatin1String("type")) {
+            criteria.fileTypes << value.split(QLatin1Char(','), Qt::SkipEmptyParts);
+            consumed = true;
+        } else if (key == QLatin1String("size")) {
+            consumed = applySize(value, criteria);
+        } else if (key == QLatin1String("modified") || key == QLatin1String("date")) {
+            consumed = applyModified(value, criteria);
+        }
+
+        if (!consumed)
+            words << unquote(token);
+    }
+
+    criteria.text = words.join(QLatin1Char(' '));
+    return criteria;
+}
@@ -0,0 +1,88 @@
+#ifndef SEARCHPLAN_H
+#define SEARCHPLAN_H
+
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringMatcher>
+#include <QStringView>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "searchmanager.h"
+#include "contentmatcher.h"
+#include "fuzzymatcher.h"
+
+struct SearchHit;
+
+class SearchPlan {
+public:
+    static const int FuzzyResultLimit = 1000;
+
+    static std::shared_ptr<const SearchPlan> compile(const SearchCriteria& criteria);
+
+    static SearchCriteria parseQuery(const QString& query, SearchCriteria criteria);
+
+    bool matches(const QFileInfo& fileInfo) const;
+
+    bool matchesMetadata(const QFileInfo& fileInfo) const;
+
+    bool matchesName(const QString& name) const;
+
+    bool matchesHit(const SearchHit& hit) const;
+
+    static bool narrows(const SearchCriteria& previous, const SearchCriteria& next);
+
+    bool isFuzzy() const { return fuzzy.isValid(); }
+
+    void rank(QVector<SearchHit>& hits) const;
+
+    bool needsContent() const { return content.isValid(); }
+
+    bool contentMatches(const QString& filePath, QStringList* members = nullptr,
+                        const std::atomic<bool>* cancelled = nullptr) const;
+
+    const SearchCriteria& criteria() const { return source; }
+
+    const ContentMatcher& contentMatcher() const { return content; }
+
+private:
+    enum class Stage {
+        Extension,
+        Name,
+        Size,
+        Modified,
+        Content
+    };
+
+    struct ExtensionHash {
+        size_t operator()(QStringView s) const;
+    };
+
+    struct ExtensionEqual {
+        bool operator()(QStringView a, QStringView b) const;
+    };
+
+    explicit SearchPlan(const SearchCriteria& criteria);
+    Q_DISABLE_COPY(SearchPlan)
+
+    template <typename Entry>
+    bool evaluate(const Entry& entry, bool readContent) const;
+
+    SearchCriteria source;
+    std::vector<Stage> stages;
+    QStringList extensionStorage;
+    std::unordered_set<QStringView, ExtensionHash, ExtensionEqual> extensions;
+    QStringMatcher nameMatcher;
+    QRegularExpression nameRegex;
+    FuzzyMatcher fuzzy;
+    bool hasNameText;
+    qint64 modifiedFrom;
+    qint64 modifiedTo;
+    ContentMatcher content;
+};
+
+#endif
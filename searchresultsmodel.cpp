@@ -0,0 +1,122 @@
+#include "searchresultsmodel.h"
+#include "iconcache.h"
+#include "searchplan.h"
+#include <QFileInfo>
+#include <QFileSystemModel>
+#include <QLocale>
+#include <algorithm>
+
+SearchResultsModel::SearchResultsModel(QObject* parent)
+    : QAbstractTableModel(parent), mounts(MountTable::read()) {
+    connect(&IconCache::shared(), &IconCache::fileIconsChanged, this, [this]() {
+        if (!hits.isEmpty())
+            emit dataChanged(index(0, 0), index(hits.size() - 1, 0), {Qt::DecorationRole});
+    });
+}
+
+int SearchResultsModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : hits.size();
+}
+
+int SearchResultsModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : 4;
+}
+
+QVariant SearchResultsModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= hits.size())
+        return QVariant();
+
+    const SearchHit& entry = hits.at(index.row());
+
+    switch (role) {
+        case QFileSystemModel::FilePathRole:
+            return entry.path;
+        case Qt::ToolTipRole:
+            return entry.member.isEmpty() ? entry.path : entry.path + QLatin1Char('/') + entry.member;
+        case QFileSystemModel::FileNameRole:
+            return entry.name;
+        case Qt::DecorationRole:
+            if (index.column() == 0) {
+                IconCache& icons = IconCache::shared();
+                if (entry.isDir)
+                    return icons.folderIcon();
+                QIcon icon = icons.iconForName(entry.name);
+                if (icon.isNull())
+                    icon = mounts.mountFor(entry.path).slow ? icons.fileIcon() : icons.iconForFile(entry.path);
+                return icon;
+            }
+            return QVariant();
+        case Qt::EditRole:
+            if (index.column() == 1)
+                return entry.size;
+            if (index.column() == 3)
+                return entry.lastModified;
+            break;
+        case Qt::TextAlignmentRole:
+            if (index.column() == 1)
+                return int(Qt::AlignRight | Qt::AlignVCenter);
+            return QVariant();
+        default:
+            break;
+    }
+
+    if (role != Qt::DisplayRole && role != Qt::EditRole)
+        return QVariant();
+
+    switch (index.column()) {
+        case 0:
+            if (!entry.member.isEmpty())
+                return entry.name + QStringLiteral(" \u203A ") + entry.member;
+            return entry.name;
+        case 1:
+            return entry.isDir ? QString() : QLocale::system().formattedDataSize(entry.size);
+        case 2:
+            if (entry.isDir)
+                return QStringLiteral("File folder");
+            return QFileInfo(entry.name).suffix().isEmpty()
+                ? QStringLiteral("File")
+                : QFileInfo(entry.name).suffix().toUpper() + QStringLiteral(" File");
+        case 3:
+            return QLocale::system().toString(entry.lastModified, QLocale::ShortFormat);
+    }
+
+    return QVariant();
+}
+
+QVariant SearchResultsModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QAbstractTableModel::headerData(section, orientation, role);
+
+    switch (section) {
+        case 0: return QStringLiteral("Name");
+        case 1: return QStringLiteral("Size");
+        case 2: return QStringLiteral("Type");
+        case 3: return QStringLiteral("Date Modified");
+    }
+    return QVariant();
+}
+
+void SearchResultsModel::appendResults(const QVector<SearchHit>& newHits) {
+    if (newHits.isEmpty())
+        return;
+
+    beginInsertRows(QModelIndex(), hits.size(), hits.size() + newHits.size() - 1);
+    hits += newHits;
+    endInsertRows();
+}
+
+void SearchResultsModel::clear() {
+    beginResetModel();
+    hits.clear();
+    mounts = MountTable::read();
+    endResetModel();
+}
+
+void SearchResultsModel::refine(const SearchPlan& plan) {
+    beginResetModel();
+    hits.erase(std::remove_if(hits.begin(), hits.end(),
+                              [&plan](const SearchHit& hit) { return !plan.matchesHit(hit); }),
+               hits.end());
+    plan.rank(hits);
+    endResetModel();
+}
@@ -0,0 +1,36 @@
+#ifndef SEARCHRESULTSMODEL_H
+#define SEARCHRESULTSMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+
+#include "mounttable.h"
+#include "searchengine.h"
+
+class SearchPlan;
+
+class SearchResultsModel : public QAbstractTableModel {
+    Q_OBJECT
+public:
+    explicit SearchResultsModel(QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    const SearchHit& hit(int row) const { return hits.at(row); }
+
+    void appendResults(const QVector<SearchHit>& newHits);
+
+    void clear();
+
+    void refine(const SearchPlan& plan);
+
+private:
+    // Read when the results are replaced, so painting never rereads the mount table.
+    MountTable mounts;
+    QVector<SearchHit> hits;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "statxbatch.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+const unsigned int RING_ENTRIES = 1024;
+
+// Set once a ring could not be created, so later threads go straight to plain statx().
+std::atomic<bool> ringUnavailable{false};
+
+// Minimal io_uring submission/completion ring that only issues IORING_OP_STATX. liburing is not a
+// dependency, so setup and ring access follow io_uring_setup(2) directly.
+class StatxRing {
+public:
+    ~StatxRing() {
+        if (sqes)
+            ::munmap(sqes, sqesSize);
+        if (cqRing && cqRing != sqRing)
+            ::munmap(cqRing, cqRingSize);
+        if (sqRing)
+            ::munmap(sqRing, sqRingSize);
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    bool setup() {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = int(::syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+        if (fd < 0)
+            return false;
+
+        entries = params.sq_entries;
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+        sqRing = map(sqRingSize, IORING_OFF_SQ_RING);
+        cqRing = single ? sqRing : map(cqRingSize, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(map(sqesSize, IORING_OFF_SQES));
+        if (!sqRing || !cqRing || !sqes)
+            return false;
+
+        char* sq = static_cast<char*>(sqRing);
+        sqHead = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+        char* cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // Returns false if the ring itself failed; per-name failures land in errors.
+    bool run(int dirFd, const char* const* names, size_t count, unsigned int mask, struct statx* results,
+             int* errors) {
+        for (size_t first = 0; first < count; first += entries) {
+            unsigned int chunk = unsigned(std::min<size_t>(entries, count - first));
+
+            unsigned int tail = *sqTail;
+            for (unsigned int i = 0; i < chunk; ++i) {
+                unsigned int slot = (tail + i) & sqMask;
+                io_uring_sqe& sqe = sqes[slot];
+                std::memset(&sqe, 0, sizeof(sqe));
+                sqe.opcode = IORING_OP_STATX;
+                sqe.fd = dirFd;
+                sqe.addr = __u64(uintptr_t(names[first + i]));
+                sqe.len = mask;
+                sqe.off = __u64(uintptr_t(&results[first + i]));
+                sqe.statx_flags = AT_STATX_SYNC_AS_STAT;
+                sqe.user_data = first + i;
+                sqArray[slot] = slot;
+            }
+            __atomic_store_n(sqTail, tail + chunk, __ATOMIC_RELEASE);
+
+            unsigned int submitted = 0;
+            unsigned int completed = 0;
+            while (completed < chunk) {
+                int got = int(::syscall(__NR_io_uring_enter, fd, chunk - submitted, chunk - completed,
+                                        IORING_ENTER_GETEVENTS, nullptr, 0));
+                if (got < 0 && errno != EINTR) {
+                    // Entries the kernel already took still write into results; they have to land before
+                    // the caller falls back to plain statx() or frees the buffers.
+                    unsigned int taken = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) - tail;
+                    drain(taken - completed);
+                    return false;
+                }
+                if (got > 0)
+                    submitted += unsigned(got);
+
+                unsigned int head = *cqHead;
+                unsigned int ready = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+                for (; head != ready; ++head) {
+                    const io_uring_cqe& cqe = cqes[head & cqMask];
+                    size_t index = size_t(cqe.user_data);
+                    errors[index] = cqe.res < 0 ? -cqe.res : 0;
+                    // Kernels before 5.6 know the ring but not the opcode.
+                    if (cqe.res == -EINVAL)
+                        errors[index] = ::statx(dirFd, names[index], AT_STATX_SYNC_AS_STAT, mask, &results[index]) == 0
+                                            ? 0 : errno;
+                    ++completed;
+                }
+                __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            }
+        }
+        return true;
+    }
+
+private:
+    int fd = -1;
+    unsigned int entries = 0;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+    unsigned int* sqHead = nullptr;
+    unsigned int* sqTail = nullptr;
+    unsigned int sqMask = 0;
+    unsigned int* sqArray = nullptr;
+    unsigned int* cqHead = nullptr;
+    unsigned int* cqTail = nullptr;
+    unsigned int cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    // Waits out inFlight completions, discarding them. The kernel posts them whether or not anyone waits,
+    // so if waiting itself fails the completion queue is polled instead.
+    void drain(unsigned int inFlight) {
+        while (inFlight > 0) {
+            int got = int(::syscall(__NR_io_uring_enter, fd, 0, inFlight, IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (got < 0 && errno != EINTR) {
+                struct timespec pause = {0, 1000000};
+                ::nanosleep(&pause, nullptr);
+            }
+
+            unsigned int head = *cqHead;
+            unsigned int ready = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            inFlight -= std::min(inFlight, ready - head);
+            __atomic_store_n(cqHead, ready, __ATOMIC_RELEASE);
+        }
+    }
+
+    void* map(size_t size, off_t offset) {
+        void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        return address == MAP_FAILED ? nullptr : address;
+    }
+};
+
+StatxRing* threadRing() {
+    thread_local std::unique_ptr<StatxRing> ring;
+    thread_local bool tried = false;
+    if (ringUnavailable.load(std::memory_order_relaxed))
+        return nullptr;
+    if (!tried) {
+        tried = true;
+        ring.reset(new StatxRing);
+        if (!ring->setup()) {
+            ring.reset();
+            ringUnavailable = true;
+        }
+    }
+    return ring.get();
+}
+
+}
+
+void statxBatch(int dirFd, const char* const* names, size_t count, unsigned int mask, struct statx* results,
+                int* errors, StatxStrategy strategy) {
+    if (count == 0)
+        return;
+
+    StatxRing* ring = strategy == StatxIoUring && count > 1 ? threadRing() : nullptr;
+    if (ring) {
+        if (ring->run(dirFd, names, count, mask, results, errors))
+            return;
+        // The ring may hold half-submitted entries now; nobody uses it again.
+        ringUnavailable = true;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+        errors[i] = ::statx(dirFd, names[i], AT_STATX_SYNC_AS_STAT, mask, &results[i]) == 0 ? 0 : errno;
+}
@@ -0,0 +1,20 @@
+#ifndef STATXBATCH_H
+#define STATXBATCH_H
+
+#include <cstddef>
+#include <sys/stat.h>
+
+enum StatxStrategy {
+    // One statx() per name. Cheapest when the inodes are cached, as they usually are on local disks.
+    StatxDirect,
+    // Queued through a per-thread io_uring: a batch costs a handful of io_uring_enter() calls and the
+    // kernel's workers overlap the round trips of network and FUSE file systems. Falls back to
+    // StatxDirect where io_uring is unavailable (old kernel, seccomp, io_uring_disabled).
+    StatxIoUring
+};
+
+// statx() for many names in one directory; errors[i] is 0 or an errno value.
+void statxBatch(int dirFd, const char* const* names, size_t count, unsigned int mask, struct statx* results,
+                int* errors, StatxStrategy strategy);
+
+#endif
@@ -7,6 +7,8 @@ HomeTab::HomeTab(QWidget *parent) : QWidget(parent)
 
     QToolBar *toolbar = new QToolBar("Home");
     toolbar->addAction("Home");
+    QAction *findDuplicatesAction = toolbar->addAction("Find duplicates");
+    connect(findDuplicatesAction, &QAction::triggered, this, &HomeTab::findDuplicatesRequested);
 
     layout->addWidget(toolbar);
     setLayout(layout);
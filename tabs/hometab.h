@@ -11,7 +11,7 @@ public:
     explicit HomeTab(QWidget *parent = nullptr);
 
 signals:
-
+    void findDuplicatesRequested();
 
 private:
 
@@ -101,8 +101,31 @@ ViewTab::ViewTab(QWidget *parent) : QWidget(parent)
     separator->setFrameShape(QFrame::VLine);
     separator->setFrameShadow(QFrame::Sunken);
 
+    QWidget *showHideSection = new QWidget;
+    QVBoxLayout *showHideLayout = new QVBoxLayout(showHideSection);
+    showHideLayout->setSpacing(2);
+    showHideLayout->setContentsMargins(0, 0, 0, 0);
+
+    QLabel *showHideLabel = new QLabel("Show/hide");
+    showHideLabel->setAlignment(Qt::AlignCenter);
+
+    QSettings settings("Explosion", "Explosion");
+    QAction *folderSizesAction = new QAction(style()->standardIcon(QStyle::SP_DriveHDIcon), "Folder sizes", this);
+    folderSizesAction->setCheckable(true);
+    folderSizesAction->setChecked(settings.value("view/folderSizes", false).toBool());
+    connect(folderSizesAction, &QAction::toggled, this, &ViewTab::folderSizesToggled);
+
+    showHideLayout->addWidget(createViewModeButton(folderSizesAction));
+    showHideLayout->addWidget(showHideLabel);
+
+    QFrame *showHideSeparator = new QFrame();
+    showHideSeparator->setFrameShape(QFrame::VLine);
+    showHideSeparator->setFrameShadow(QFrame::Sunken);
+
     groupLayout->addWidget(viewModeSection);
     groupLayout->addWidget(separator);
+    groupLayout->addWidget(showHideSection);
+    groupLayout->addWidget(showHideSeparator);
     groupLayout->addStretch();
 
     layout->addWidget(viewGroup);
@@ -11,6 +11,7 @@
 #include <QLabel>
 #include <QFrame>
 #include <QStyle>
+#include <QSettings>
 #include "../fileviewmodel.h"
 
 class ViewTab : public QWidget {
@@ -20,6 +21,7 @@ public:
 
 signals:
     void viewModeChanged(ViewMode mode);
+    void folderSizesToggled(bool enabled);
 
 private:
     QActionGroup *viewModeGroup;
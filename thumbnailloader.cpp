@@ -0,0 +1,508 @@
+#include "thumbnailloader.h"
+#include "directorymodel.h"
+#include <QAbstractItemView>
+#include <QAbstractProxyModel>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemModel>
+#include <QImageReader>
+#include <QLoggingCategory>
+#include <QPersistentModelIndex>
+#include <QPointer>
+#include <QProcess>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+Q_LOGGING_CATEGORY(lcThumbnails, "explosion.thumbnails", QtInfoMsg)
+
+namespace {
+
+const int DELIVER_INTERVAL_MS = 30;
+const qint64 DEFAULT_CACHE_BUDGET_MB = 64;
+const int THUMBNAILER_TIMEOUT_MS = 10000;
+const int THUMBNAILER_POLL_MS = 100;
+const int EXIT_WAIT_MS = 500;
+
+}
+
+struct ThumbnailJob {
+    QString key;
+    QString path;
+    int size = 0;
+    qreal devicePixelRatio = 1;
+    QStringList command;
+    QString cacheRoot;
+    QPersistentModelIndex index;
+    QPointer<QAbstractItemView> view;
+
+    // Written by the worker before finished is set.
+    QImage image;
+    bool fromDisk = false;
+    std::atomic<bool> finished{false};
+    std::atomic<bool> cancelled{false};
+};
+
+namespace {
+
+// The reader decodes straight to the target size where the format allows it, which for JPEG means
+// decoding only a fraction of the DCT coefficients rather than the full image.
+QImage readScaled(const QString& path, int size, const std::atomic<bool>& cancelled) {
+    QImageReader reader(path);
+    reader.setAutoTransform(true);
+    QSize full = reader.size();
+    if (full.isValid() && (full.width() > size || full.height() > size))
+        reader.setScaledSize(full.scaled(size, size, Qt::KeepAspectRatio));
+    if (cancelled.load())
+        return QImage();
+
+    QImage image = reader.read();
+    // Formats that cannot report their size up front are decoded in full and scaled afterwards.
+    if (!image.isNull() && (image.width() > size || image.height() > size))
+        image = image.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    return image;
+}
+
+QString expandArgument(const QString& argument, const QString& input, const QString& output, int size) {
+    QString expanded;
+    for (qsizetype i = 0; i < argument.size(); ++i) {
+        if (argument[i] != QLatin1Char('%') || i + 1 == argument.size()) {
+            expanded.append(argument[i]);
+            continue;
+        }
+        switch (argument[++i].unicode()) {
+            case 'i': expanded.append(input); break;
+            case 'u': expanded.append(QUrl::fromLocalFile(input).toString(QUrl::FullyEncoded)); break;
+            case 'o': expanded.append(output); break;
+            case 's': expanded.append(QString::number(size)); break;
+            default: expanded.append(argument[i]); break;
+        }
+    }
+    return expanded;
+}
+
+QImage runThumbnailer(const QStringList& command, const QString& path, int size, const std::atomic<bool>& cancelled) {
+    QTemporaryFile output(QDir::tempPath() + QLatin1String("/explosion-thumbnail-XXXXXX.png"));
+    if (!output.open())
+        return QImage();
+    output.close();
+
+    QStringList arguments;
+    for (const QString& argument : command)
+        arguments.append(expandArgument(argument, path, output.fileName(), size));
+    QString program = arguments.takeFirst();
+
+    QProcess process;
+    process.setStandardOutputFile(QProcess::nullDevice());
+    process.setStandardErrorFile(QProcess::nullDevice());
+    process.start(program, arguments);
+    if (!process.waitForStarted())
+        return QImage();
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    while (process.state() != QProcess::NotRunning && !process.waitForFinished(THUMBNAILER_POLL_MS)) {
+        if (cancelled.load() || elapsed.elapsed() > THUMBNAILER_TIMEOUT_MS) {
+            process.kill();
+            process.waitForFinished();
+            return QImage();
+        }
+    }
+    if (process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0)
+        return QImage();
+    return readScaled(output.fileName(), size, cancelled);
+}
+
+struct CacheBucket {
+    const char* directory;
+    int size;
+};
+
+const CacheBucket CACHE_BUCKETS[] = {{"normal", 128}, {"large", 256}, {"x-large", 512}, {"xx-large", 1024}};
+
+const CacheBucket& bucketFor(int size) {
+    for (const CacheBucket& bucket : CACHE_BUCKETS) {
+        if (size <= bucket.size)
+            return bucket;
+    }
+    return CACHE_BUCKETS[std::size(CACHE_BUCKETS) - 1];
+}
+
+// A cached thumbnail is only used while the file keeps the modification time (and size, when recorded)
+// it was made from.
+QImage readCached(const QString& file, const QString& uri, const QString& mtime, qint64 size, int target) {
+    QImageReader reader(file, "png");
+    if (!reader.canRead() || reader.text(QStringLiteral("Thumb::MTime")) != mtime ||
+        reader.text(QStringLiteral("Thumb::URI")) != uri)
+        return QImage();
+    QString cachedSize = reader.text(QStringLiteral("Thumb::Size"));
+    if (!cachedSize.isEmpty() && cachedSize != QString::number(size))
+        return QImage();
+
+    QSize full = reader.size();
+    if (full.isValid() && (full.width() > target || full.height() > target))
+        reader.setScaledSize(full.scaled(target, target, Qt::KeepAspectRatio));
+    return reader.read();
+}
+
+// Written under a temporary name and renamed into place, so other programs never see a partial file.
+void writeCached(const QString& file, QImage image, const QString& uri, const QString& mtime, qint64 size) {
+    QString directory = QFileInfo(file).path();
+    if (!QFileInfo::exists(directory)) {
+        QDir().mkpath(directory);
+        QFile::setPermissions(directory, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+    }
+
+    image.setText(QStringLiteral("Thumb::URI"), uri);
+    image.setText(QStringLiteral("Thumb::MTime"), mtime);
+    image.setText(QStringLiteral("Thumb::Size"), QString::number(size));
+    image.setText(QStringLiteral("Software"), QStringLiteral("Explosion"));
+
+    QSaveFile output(file);
+    if (!output.open(QIODevice::WriteOnly) || !image.save(&output, "png"))
+        return;
+    output.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+    output.commit();
+}
+
+void renderThumbnail(ThumbnailJob& job) {
+    QFileInfo info(job.path);
+    QString uri = QString::fromLatin1(QUrl::fromLocalFile(job.path).toEncoded());
+    QString mtime = QString::number(info.lastModified().toSecsSinceEpoch());
+    QString name = QString::fromLatin1(QCryptographicHash::hash(uri.toLatin1(), QCryptographicHash::Md5).toHex()) +
+                   QLatin1String(".png");
+    const CacheBucket& bucket = bucketFor(job.size);
+    // The spec forbids thumbnailing the thumbnails themselves into the cache.
+    bool cacheable = !job.cacheRoot.isEmpty() && !job.path.startsWith(job.cacheRoot + QLatin1Char('/'));
+
+    QString cachedFile = job.cacheRoot + QLatin1Char('/') + QLatin1String(bucket.directory) + QLatin1Char('/') + name;
+    QString failedFile = job.cacheRoot + QLatin1String("/fail/explosion/") + name;
+    if (cacheable) {
+        job.image = readCached(cachedFile, uri, mtime, info.size(), job.size);
+        if (!job.image.isNull()) {
+            job.fromDisk = true;
+            return;
+        }
+        if (!readCached(failedFile, uri, mtime, info.size(), 1).isNull())
+            return;
+    }
+    if (job.cancelled.load())
+        return;
+
+    // Made at the size of the cache bucket so it serves every view that shares the bucket.
+    int size = cacheable ? bucket.size : job.size;
+    QImage image = job.command.isEmpty() ? readScaled(job.path, size, job.cancelled)
+                                         : runThumbnailer(job.command, job.path, size, job.cancelled);
+    if (job.cancelled.load())
+        return;
+    if (image.isNull()) {
+        if (cacheable) {
+            QImage marker(1, 1, QImage::Format_ARGB32);
+            marker.fill(Qt::transparent);
+            writeCached(failedFile, marker, uri, mtime, info.size());
+        }
+        return;
+    }
+
+    if (cacheable)
+        writeCached(cachedFile, image, uri, mtime, info.size());
+    if (image.width() > job.size || image.height() > job.size)
+        image = image.scaled(job.size, job.size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    job.image = image;
+}
+
+bool isVisible(const ThumbnailJob& job, QRect* rect = nullptr) {
+    QAbstractItemView* view = job.view.data();
+    if (!view || !view->isVisible() || !job.index.isValid() || job.index.model() != view->model())
+        return false;
+
+    QRect itemRect = view->visualRect(job.index);
+    if (rect)
+        *rect = itemRect;
+    return itemRect.intersects(view->viewport()->rect());
+}
+
+// Both listing models keep the time behind their own API, since QFileSystemModel's column only holds text;
+// the result models answer with a QDateTime in their date column.
+QDateTime lastModified(const QModelIndex& index) {
+    QModelIndex source = index;
+    while (auto proxy = qobject_cast<const QAbstractProxyModel*>(source.model()))
+        source = proxy->mapToSource(source);
+    if (auto listing = qobject_cast<const DirectoryModel*>(source.model()))
+        return listing->lastModified(source);
+    if (auto listing = qobject_cast<const QFileSystemModel*>(source.model()))
+        return listing->lastModified(source);
+    return index.siblingAtColumn(3).data(Qt::EditRole).toDateTime();
+}
+
+}
+
+ThumbnailLoader::ThumbnailLoader(QObject* parent)
+    : QObject(parent), pool(new QThreadPool), dispatchTimer(new QTimer(this)), deliverTimer(new QTimer(this)),
+      maxRunning(qBound(2, QThread::idealThreadCount() / 2, 4)), thumbnailersLoaded(false),
+      cacheRoot(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/thumbnails")),
+      memoryHits(0), memoryMisses(0), diskHits(0), generated(0), failures(0) {
+    pool->setMaxThreadCount(maxRunning);
+    pool->setThreadPriority(QThread::LowestPriority);
+
+    QSettings settings("Explosion", "Explosion");
+    setCacheBudget(settings.value("thumbnails/cacheBudgetMB", DEFAULT_CACHE_BUDGET_MB).toLongLong() * 1024 * 1024);
+
+    const QList<QByteArray> formats = QImageReader::supportedImageFormats();
+    for (const QByteArray& format : formats)
+        imageSuffixes.insert(QString::fromLatin1(format).toLower());
+
+    // Everything one paint pass asks for is sorted and started together.
+    dispatchTimer->setSingleShot(true);
+    dispatchTimer->setInterval(0);
+    connect(dispatchTimer, &QTimer::timeout, this, &ThumbnailLoader::dispatch);
+
+    deliverTimer->setInterval(DELIVER_INTERVAL_MS);
+    connect(deliverTimer, &QTimer::timeout, this, &ThumbnailLoader::deliver);
+}
+
+ThumbnailLoader::~ThumbnailLoader() {
+    for (const std::shared_ptr<ThumbnailJob>& job : running)
+        job->cancelled = true;
+
+    // Reading a file on a hung network mount cannot be interrupted; as with metadata, leak the pool then.
+    if (pool->waitForDone(EXIT_WAIT_MS))
+        delete pool;
+}
+
+QPixmap ThumbnailLoader::thumbnail(const QModelIndex& index, const QWidget* view, int size) {
+    QString path = index.data(QFileSystemModel::FilePathRole).toString();
+    QStringList command;
+    if (path.isEmpty() || !supports(path, &command))
+        return QPixmap();
+
+    qreal ratio = view ? view->devicePixelRatioF() : 1;
+    int pixels = int(std::ceil(size * ratio));
+    // The listing's modification time keeps an edited file from showing, or failing with, its old contents.
+    // Until the listing knows it nothing is queued; the row is repainted when it arrives.
+    QDateTime modified = lastModified(index);
+    if (!modified.isValid())
+        return QPixmap();
+    QString key = QString::number(pixels) + QLatin1Char(':') + QString::number(modified.toMSecsSinceEpoch()) +
+                  QLatin1Char(':') + path;
+    if (failed.contains(key))
+        return QPixmap();
+    if (QPixmap* pixmap = pixmaps.object(key)) {
+        ++memoryHits;
+        return *pixmap;
+    }
+    ++memoryMisses;
+
+    std::shared_ptr<ThumbnailJob>& job = jobs[key];
+    if (!job) {
+        job = std::make_shared<ThumbnailJob>();
+        job->key = key;
+        job->path = path;
+        job->size = pixels;
+        job->devicePixelRatio = ratio;
+        job->command = command;
+        job->cacheRoot = cacheRoot;
+        pending.push_back(job);
+    }
+    // The same file may be shown by another view or row by now; follow it there.
+    job->index = index;
+    job->view = qobject_cast<QAbstractItemView*>(const_cast<QWidget*>(view));
+    dispatchTimer->start();
+    return QPixmap();
+}
+
+void ThumbnailLoader::setCacheBudget(qint64 bytes) {
+    pixmaps.setMaxCost(qMax<qint64>(0, bytes));
+}
+
+ThumbnailLoader::CacheStats ThumbnailLoader::cacheStats() const {
+    return {memoryHits, memoryMisses, diskHits, generated, failures, qint64(pixmaps.totalCost()), pixmaps.size()};
+}
+
+bool ThumbnailLoader::supports(const QString& path, QStringList* command) {
+    QString suffix = QFileInfo(path).suffix().toLower();
+    if (suffix.isEmpty() || unsupportedSuffixes.contains(suffix))
+        return false;
+
+    auto it = commands.constFind(suffix);
+    if (it != commands.constEnd()) {
+        *command = *it;
+        return true;
+    }
+
+    if (imageSuffixes.contains(suffix)) {
+        commands.insert(suffix, QStringList());
+        command->clear();
+        return true;
+    }
+
+    loadThumbnailers();
+    QMimeType mimeType = mimeDatabase.mimeTypeForFile(path, QMimeDatabase::MatchExtension);
+    for (const Thumbnailer& thumbnailer : thumbnailers) {
+        for (const QString& type : thumbnailer.mimeTypes) {
+            if (mimeType.inherits(type)) {
+                commands.insert(suffix, thumbnailer.command);
+                *command = thumbnailer.command;
+                return true;
+            }
+        }
+    }
+    unsupportedSuffixes.insert(suffix);
+    return false;
+}
+
+// Thumbnailers are described by .thumbnailer files; one in the user's data directory hides a system one
+// with the same name.
+void ThumbnailLoader::loadThumbnailers() {
+    if (thumbnailersLoaded)
+        return;
+    thumbnailersLoaded = true;
+
+    QSet<QString> seen;
+    const QStringList directories = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation,
+                                                              QStringLiteral("thumbnailers"),
+                                                              QStandardPaths::LocateDirectory);
+    for (const QString& directory : directories) {
+        const QStringList files = QDir(directory).entryList({QStringLiteral("*.thumbnailer")}, QDir::Files);
+        for (const QString& name : files) {
+            if (seen.contains(name))
+                continue;
+            seen.insert(name);
+
+            QFile file(directory + QLatin1Char('/') + name);
+            if (!file.open(QIODevice::ReadOnly))
+                continue;
+
+            Thumbnailer thumbnailer;
+            QString tryExec;
+            bool inEntry = false;
+            const QStringList lines = QString::fromUtf8(file.readAll()).split(QLatin1Char('\n'));
+            for (const QString& rawLine : lines) {
+                QString line = rawLine.trimmed();
+                if (line.startsWith(QLatin1Char('['))) {
+                    inEntry = line == QLatin1String("[Thumbnailer Entry]");
+                    continue;
+                }
+                qsizetype equals = line.indexOf(QLatin1Char('='));
+                if (!inEntry || equals < 0)
+                    continue;
+
+                QString key = line.left(equals).trimmed();
+                QString value = line.mid(equals + 1).trimmed();
+                if (key == QLatin1String("Exec"))
+                    thumbnailer.command = QProcess::splitCommand(value);
+                else if (key == QLatin1String("TryExec"))
+                    tryExec = value;
+                else if (key == QLatin1String("MimeType"))
+                    thumbnailer.mimeTypes = value.split(QLatin1Char(';'), Qt::SkipEmptyParts);
+            }
+
+            if (thumbnailer.command.isEmpty() || thumbnailer.mimeTypes.isEmpty())
+                continue;
+            if (QStandardPaths::findExecutable(tryExec.isEmpty() ? thumbnailer.command.first() : tryExec).isEmpty())
+                continue;
+            thumbnailers.append(thumbnailer);
+        }
+    }
+}
+
+void ThumbnailLoader::dispatch() {
+    // A running job whose item left the viewport stops at its next step; its thread is not waited for.
+    for (const std::shared_ptr<ThumbnailJob>& job : running) {
+        if (!isVisible(*job))
+            job->cancelled = true;
+    }
+
+    std::vector<std::pair<QRect, std::shared_ptr<ThumbnailJob>>> visible;
+    visible.reserve(pending.size());
+    for (const std::shared_ptr<ThumbnailJob>& job : pending) {
+        QRect rect;
+        if (isVisible(*job, &rect))
+            visible.emplace_back(rect, job);
+        else
+            jobs.remove(job->key);
+    }
+    std::stable_sort(visible.begin(), visible.end(), [](const auto& a, const auto& b) {
+        return a.first.top() != b.first.top() ? a.first.top() < b.first.top() : a.first.left() < b.first.left();
+    });
+
+    pending.clear();
+    for (auto& entry : visible) {
+        std::shared_ptr<ThumbnailJob>& job = entry.second;
+        if (int(running.size()) >= maxRunning) {
+            pending.push_back(std::move(job));
+            continue;
+        }
+
+        running.push_back(job);
+        pool->start([job]() {
+            if (!job->cancelled.load())
+                renderThumbnail(*job);
+            job->finished.store(true, std::memory_order_release);
+        });
+    }
+
+    if (!running.empty())
+        deliverTimer->start();
+}
+
+void ThumbnailLoader::deliver() {
+    bool finishedAny = false;
+    for (auto it = running.begin(); it != running.end();) {
+        std::shared_ptr<ThumbnailJob> job = *it;
+        if (!job->finished.load(std::memory_order_acquire)) {
+            ++it;
+            continue;
+        }
+        it = running.erase(it);
+        finishedAny = true;
+        jobs.remove(job->key);
+
+        QRect rect;
+        if (job->image.isNull()) {
+            // A cancelled job whose item came back into view is asked for again by repainting the item.
+            if (!job->cancelled.load()) {
+                failed.insert(job->key);
+                ++failures;
+            } else if (isVisible(*job, &rect)) {
+                job->view->viewport()->update(rect);
+            }
+            continue;
+        }
+
+        if (job->fromDisk)
+            ++diskHits;
+        else
+            ++generated;
+        QPixmap* pixmap = new QPixmap(QPixmap::fromImage(job->image));
+        pixmap->setDevicePixelRatio(job->devicePixelRatio);
+        pixmaps.insert(job->key, pixmap, job->image.sizeInBytes());
+
+        if (isVisible(*job, &rect))
+            job->view->viewport()->update(rect);
+    }
+
+    if (finishedAny) {
+        qCDebug(lcThumbnails) << "Thumbnail cache memory hits" << memoryHits << "misses" << memoryMisses
+                              << "disk hits" << diskHits << "generated" << generated << "failed" << failures
+                              << "bytes" << pixmaps.totalCost();
+    }
+    if (finishedAny && !pending.empty())
+        dispatch();
+    if (running.empty())
+        deliverTimer->stop();
+}
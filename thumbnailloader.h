@@ -0,0 +1,90 @@
+#ifndef THUMBNAILLOADER_H
+#define THUMBNAILLOADER_H
+
+#include <QCache>
+#include <QHash>
+#include <QMimeDatabase>
+#include <QObject>
+#include <QPixmap>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include <vector>
+
+class QModelIndex;
+class QThreadPool;
+class QTimer;
+class QWidget;
+struct ThumbnailJob;
+
+// Produces thumbnails for images, and for PDFs, videos and anything else a freedesktop thumbnailer is
+// installed for, on a background pool. Only requests whose items are still inside their view's viewport
+// are started, topmost first; requests for items scrolled out of view are dropped or cancelled.
+//
+// Thumbnails are shared with other desktop software through ~/.cache/thumbnails as the freedesktop.org
+// Thumbnail Managing Standard lays out, and the pixmaps last shown are kept in memory in front of that.
+class ThumbnailLoader : public QObject {
+    Q_OBJECT
+public:
+    explicit ThumbnailLoader(QObject* parent = nullptr);
+    ~ThumbnailLoader();
+
+    // Called while painting index in view: returns the thumbnail if it is ready, otherwise queues it and
+    // returns a null pixmap. The item is repainted once the thumbnail arrives.
+    QPixmap thumbnail(const QModelIndex& index, const QWidget* view, int size);
+
+    struct CacheStats {
+        qint64 memoryHits;
+        qint64 memoryMisses;
+        qint64 diskHits;
+        qint64 generated;
+        qint64 failures;
+        qint64 bytes;
+        qsizetype pixmaps;
+    };
+
+    CacheStats cacheStats() const;
+
+    // Bytes of decoded pixmaps kept in memory.
+    void setCacheBudget(qint64 bytes);
+
+private:
+    struct Thumbnailer {
+        QStringList mimeTypes;
+        QStringList command;
+    };
+
+    QThreadPool* pool;
+    QTimer* dispatchTimer;
+    QTimer* deliverTimer;
+    int maxRunning;
+
+    QMimeDatabase mimeDatabase;
+    QSet<QString> imageSuffixes;
+    QVector<Thumbnailer> thumbnailers;
+    bool thumbnailersLoaded;
+    // Per suffix: the thumbnailer command, empty for images Qt decodes itself; absent when not supported.
+    QHash<QString, QStringList> commands;
+    QSet<QString> unsupportedSuffixes;
+
+    QString cacheRoot;
+    QCache<QString, QPixmap> pixmaps;
+    qint64 memoryHits;
+    qint64 memoryMisses;
+    qint64 diskHits;
+    qint64 generated;
+    qint64 failures;
+    QSet<QString> failed;
+    QHash<QString, std::shared_ptr<ThumbnailJob>> jobs;
+    std::vector<std::shared_ptr<ThumbnailJob>> pending;
+    std::vector<std::shared_ptr<ThumbnailJob>> running;
+
+    bool supports(const QString& path, QStringList* command);
+    void loadThumbnailers();
+    void dispatch();
+    void deliver();
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "xxhash64.h"
+#include <cstring>
+
+namespace {
+
+const quint64 PRIME1 = 11400714785074694791ULL;
+const quint64 PRIME2 = 14029467366897019727ULL;
+const quint64 PRIME3 = 1609587929392839161ULL;
+const quint64 PRIME4 = 9650029242287828579ULL;
+const quint64 PRIME5 = 2870177450012600261ULL;
+
+inline quint64 rotl(quint64 value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline quint64 read64(const unsigned char* p) {
+    quint64 value;
+    std::memcpy(&value, p, sizeof(value));
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+inline quint32 read32(const unsigned char* p) {
+    quint32 value;
+    std::memcpy(&value, p, sizeof(value));
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+inline quint64 mixLane(quint64 accumulator, quint64 input) {
+    accumulator += input * PRIME2;
+    accumulator = rotl(accumulator, 31);
+    return accumulator * PRIME1;
+}
+
+inline quint64 mergeRound(quint64 accumulator, quint64 value) {
+    accumulator ^= mixLane(0, value);
+    return accumulator * PRIME1 + PRIME4;
+}
+
+}
+
+XxHash64::XxHash64(quint64 seed)
+    : seed(seed), buffered(0), totalLength(0) {
+    lanes[0] = seed + PRIME1 + PRIME2;
+    lanes[1] = seed + PRIME2;
+    lanes[2] = seed;
+    lanes[3] = seed - PRIME1;
+}
+
+void XxHash64::update(const char* data, qsizetype size) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    totalLength += quint64(size);
+
+    if (buffered + size < 32) {
+        std::memcpy(buffer + buffered, p, size_t(size));
+        buffered += size;
+        return;
+    }
+
+    if (buffered > 0) {
+        qsizetype fill = 32 - buffered;
+        std::memcpy(buffer + buffered, p, size_t(fill));
+        for (int lane = 0; lane < 4; ++lane)
+            lanes[lane] = mixLane(lanes[lane], read64(buffer + lane * 8));
+        p += fill;
+        buffered = 0;
+    }
+
+    quint64 v1 = lanes[0], v2 = lanes[1], v3 = lanes[2], v4 = lanes[3];
+    while (end - p >= 32) {
+        v1 = mixLane(v1, read64(p));
+        v2 = mixLane(v2, read64(p + 8));
+        v3 = mixLane(v3, read64(p + 16));
+        v4 = mixLane(v4, read64(p + 24));
+        p += 32;
+    }
+    lanes[0] = v1;
+    lanes[1] = v2;
+    lanes[2] = v3;
+    lanes[3] = v4;
+
+    buffered = end - p;
+    std::memcpy(buffer, p, size_t(buffered));
+}
+
+quint64 XxHash64::digest() const {
+    quint64 h;
+    if (totalLength >= 32) {
+        h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+        for (int lane = 0; lane < 4; ++lane)
+            h = mergeRound(h, lanes[lane]);
+    } else {
+        h = seed + PRIME5;
+    }
+    h += totalLength;
+
+    const unsigned char* p = buffer;
+    const unsigned char* end = buffer + buffered;
+    while (end - p >= 8) {
+        h ^= mixLane(0, read64(p));
+        h = rotl(h, 27) * PRIME1 + PRIME4;
+        p += 8;
+    }
+    if (end - p >= 4) {
+        h ^= quint64(read32(p)) * PRIME1;
+        h = rotl(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= quint64(*p) * PRIME5;
+        h = rotl(h, 11) * PRIME1;
+        ++p;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+quint64 XxHash64::hash(const char* data, qsizetype size, quint64 seed) {
+    XxHash64 state(seed);
+    state.update(data, size);
+    return state.digest();
+}
@@ -0,0 +1,24 @@
+#ifndef XXHASH64_H
+#define XXHASH64_H
+
+#include <QtGlobal>
+
+class XxHash64 {
+public:
+    explicit XxHash64(quint64 seed = 0);
+
+    void update(const char* data, qsizetype size);
+
+    quint64 digest() const;
+
+    static quint64 hash(const char* data, qsizetype size, quint64 seed = 0);
+
+private:
+    quint64 seed;
+    quint64 lanes[4];
+    unsigned char buffer[32];
+    qsizetype buffered;
+    quint64 totalLength;
+};
+
+#endif